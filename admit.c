@@ -0,0 +1,133 @@
+// Author: Alexandros Sacranie
+// Module: Safety Critical Monitor (admit.c)
+// Project: Distributed Elevator Control System
+
+/* Call admission control
+
+    Under overload the controller answers excess calls with BUSY at once
+    rather than letting every caller wait on a growing backlog. Calls are
+    answered by a few workers, so the backlog builds in the workers' queue
+    and the listen backlog; a call that waited there longer than the queue
+    bound is shed, which drains a saturated queue quickly. A bound on calls
+    in flight caps those being answered, and a token bucket per source
+    floor keeps one floor hammering its call pad from crowding out the
+    rest of the building.
+*/
+
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "admit.h"
+#include "traffic.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+
+// Token bucket of one source floor
+typedef struct
+{
+    double tokens;
+    long last_ms;
+} bucket_t;
+
+static pthread_mutex_t g_mtx = PTHREAD_MUTEX_INITIALIZER;
+static int g_max_inflight = ADMIT_DEFAULT_INFLIGHT;
+static int g_max_queue_ms = ADMIT_DEFAULT_QUEUE_MS;
+static double g_rate_per_ms = 0.0;
+static double g_burst = 0.0;
+static bucket_t g_buckets[TRAFFIC_FLOORS];
+static admit_stats_t g_stats;
+
+//                  Limits                  //
+
+void admit_init(int max_inflight, int max_queue_ms, double rate_per_s, int burst)
+{
+    pthread_mutex_lock(&g_mtx);
+    g_max_inflight = max_inflight > 0 ? max_inflight : 0;
+    g_max_queue_ms = max_queue_ms > 0 ? max_queue_ms : 0;
+    g_rate_per_ms = rate_per_s > 0.0 ? rate_per_s / 1000.0 : 0.0;
+    g_burst = burst > 0 ? (double)burst : 1.0;
+    // Every floor starts with a full bucket
+    for (int f = 0; f < TRAFFIC_FLOORS; ++f)
+    {
+        g_buckets[f].tokens = g_burst;
+        g_buckets[f].last_ms = -1;
+    }
+    pthread_mutex_unlock(&g_mtx);
+}
+
+static bool take_token(int src_floor, long now_ms)
+{
+    if (g_rate_per_ms <= 0.0 || src_floor < TRAFFIC_MIN_FLOOR || src_floor > TRAFFIC_MAX_FLOOR)
+    {
+        return true;
+    }
+    bucket_t* b = &g_buckets[src_floor - TRAFFIC_MIN_FLOOR];
+    // Refill for the time since the floor's last call, up to the burst
+    if (b->last_ms >= 0 && now_ms > b->last_ms)
+    {
+        b->tokens += (double)(now_ms - b->last_ms) * g_rate_per_ms;
+        if (b->tokens > g_burst)
+        {
+            b->tokens = g_burst;
+        }
+    }
+    b->last_ms = now_ms;
+    if (b->tokens < 1.0)
+    {
+        return false;
+    }
+    b->tokens -= 1.0;
+    return true;
+}
+
+admit_result_t admit_call(int src_floor, long now_ms, long queued_ms)
+{
+    admit_result_t result = ADMIT_OK;
+    pthread_mutex_lock(&g_mtx);
+    // Shed before spending a token so a full controller does not drain buckets
+    if (g_max_queue_ms > 0 && queued_ms > g_max_queue_ms)
+    {
+        g_stats.shed_queue++;
+        result = ADMIT_STALE;
+    }
+    else if (g_max_inflight > 0 && g_stats.inflight >= g_max_inflight)
+    {
+        g_stats.shed_busy++;
+        result = ADMIT_BUSY;
+    }
+    else if (!take_token(src_floor, now_ms))
+    {
+        g_stats.shed_rate++;
+        result = ADMIT_RATE;
+    }
+    else
+    {
+        g_stats.admitted++;
+        g_stats.inflight++;
+        if (g_stats.inflight > g_stats.peak)
+        {
+            g_stats.peak = g_stats.inflight;
+        }
+    }
+    pthread_mutex_unlock(&g_mtx);
+    return result;
+}
+
+void admit_done(void)
+{
+    pthread_mutex_lock(&g_mtx);
+    if (g_stats.inflight > 0)
+    {
+        g_stats.inflight--;
+    }
+    pthread_mutex_unlock(&g_mtx);
+}
+
+void admit_stats(admit_stats_t* out)
+{
+    pthread_mutex_lock(&g_mtx);
+    *out = g_stats;
+    pthread_mutex_unlock(&g_mtx);
+}
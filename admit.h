@@ -0,0 +1,45 @@
+#ifndef ADMIT_H
+#define ADMIT_H
+
+#include <stdint.h>
+
+// Calls handled at once unless configured (0 means unlimited)
+#define ADMIT_DEFAULT_INFLIGHT 128
+// Longest a call may wait for a worker before it is shed (0 means unlimited)
+#define ADMIT_DEFAULT_QUEUE_MS 250
+
+// Outcome of asking to admit a call
+typedef enum
+{
+    ADMIT_OK,          // Handle the call, then call admit_done
+    ADMIT_BUSY,        // Too many calls in flight
+    ADMIT_STALE,       // The call waited too long for a worker
+    ADMIT_RATE         // The source floor is over its rate
+} admit_result_t;
+
+// Admission counters for the STATS frame
+typedef struct {
+  int inflight;           // Calls admitted and not yet answered
+  int peak;               // Most calls ever in flight at once
+  uint64_t admitted;      // Calls admitted
+  uint64_t shed_busy;     // Calls refused because too many were in flight
+  uint64_t shed_queue;    // Calls refused because they waited too long for a worker
+  uint64_t shed_rate;     // Calls refused by a source floor's rate limit
+} admit_stats_t;
+
+// Bound calls in flight and the time a call may wait for a worker (0 for
+// no bound), and limit each source floor to rate_per_s calls a second with
+// bursts of up to burst calls (rate 0 for no limit)
+void admit_init(int max_inflight, int max_queue_ms, double rate_per_s, int burst);
+
+// Decide whether a call from src_floor that waited queued_ms for a worker
+// is handled; now_ms is monotonic
+admit_result_t admit_call(int src_floor, long now_ms, long queued_ms);
+
+// Release the slot of an admitted call once it has been answered
+void admit_done(void);
+
+// Copy the current counters
+void admit_stats(admit_stats_t* out);
+
+#endif // ADMIT_H
@@ -0,0 +1,214 @@
+// Author: Alexandros Sacranie
+// Module: Safety Critical Monitor (bench_floor.c)
+// Project: Distributed Elevator Control System
+
+/* Floor codec benchmark
+
+    Checks that floor_num_handler and index_handler in libelevator.a give
+    the same results as the strtol and snprintf versions they replaced
+    (except that numbers outside B99 to 999 now format as empty names),
+    over every floor and every short token built from digits, signs,
+    spaces and letters, then times both over the same inputs and prints
+    the cost per call. Run by 'make bench'; it is not part of the build.
+*/
+
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "parse_util.h"
+#include "time_util.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Calls timed per implementation and direction
+#define BENCH_CALLS 20000000
+
+// Keeps the compiler from discarding the results
+static volatile int g_sink;
+
+//                  Reference Versions                  //
+
+static int floor_num_strtol(const char *f, int *out)
+{
+    if (!f || !*f)
+    {
+        return 0;
+    }
+    char *end = NULL;
+    if (f[0] == 'b' || f[0] == 'B')
+    {
+        long i = strtol(f + 1, &end, 10);
+        if (end == f + 1 || i < 1 || i > 99)
+        {
+            return 0;
+        }
+        *out = -(int)i;
+        return 1;
+    }
+    long i = strtol(f, &end, 10);
+    if (end == f || i < 1 || i > 999)
+    {
+        return 0;
+    }
+    *out = (int)i;
+    return 1;
+}
+
+static void index_snprintf(int index, char out[4])
+{
+    // Wide enough for any int, then cut to the name as before
+    char name[16];
+    if (index < 0)
+    {
+        snprintf(name, sizeof name, "B%d", -index);
+    }
+    else
+    {
+        snprintf(name, sizeof name, "%d", index);
+    }
+    memcpy(out, name, 3);
+    out[3] = '\0';
+}
+
+//                  Equivalence                  //
+
+// Compare both parsers on one token; returns 1 if they agree
+static int same_parse(const char *token)
+{
+    int a = 0, b = 0;
+    int ok_a = floor_num_handler(token, &a);
+    int ok_b = floor_num_strtol(token, &b);
+    if (ok_a != ok_b || (ok_a && a != b))
+    {
+        fprintf(stderr, "floor_num_handler(\"%s\") gave %d/%d, strtol %d/%d\n", token, ok_a, a, ok_b, b);
+        return 0;
+    }
+    return 1;
+}
+
+static int check(void)
+{
+    // Every token of up to four characters from this alphabet
+    static const char alphabet[] = "0123456789Bb+- x";
+    const int n = (int)sizeof alphabet - 1;
+    char token[5];
+    int bad = 0;
+    for (int len = 1; len <= 4; ++len)
+    {
+        int total = 1;
+        for (int k = 0; k < len; ++k)
+        {
+            total *= n;
+        }
+        for (int t = 0; t < total; ++t)
+        {
+            int rest = t;
+            for (int k = 0; k < len; ++k)
+            {
+                token[k] = alphabet[rest % n];
+                rest /= n;
+            }
+            token[len] = '\0';
+            bad += !same_parse(token);
+        }
+    }
+    // Every floor either side of the table, formatted and parsed back;
+    // numbers outside it have no name
+    for (int floor = -1200; floor <= 1200; ++floor)
+    {
+        char a[4], b[4];
+        index_handler(floor, a);
+        index_snprintf(floor, b);
+        if (floor < -99 || floor > 999)
+        {
+            b[0] = '\0';
+        }
+        if (strcmp(a, b) != 0)
+        {
+            fprintf(stderr, "index_handler(%d) gave \"%s\", snprintf \"%s\"\n", floor, a, b);
+            bad++;
+        }
+        bad += !same_parse(b);
+    }
+    return bad;
+}
+
+//                  Timing                  //
+
+// Nanoseconds per call of a parser over the names
+static double time_parse(int (*parse)(const char *, int *), char names[][4], int n_names)
+{
+    long long start = mono_ns();
+    int sum = 0;
+    for (int i = 0; i < BENCH_CALLS; ++i)
+    {
+        int v = 0;
+        parse(names[i % n_names], &v);
+        sum += v;
+    }
+    g_sink = sum;
+    return (double)(mono_ns() - start) / BENCH_CALLS;
+}
+
+// Nanoseconds per call of a formatter over the floors
+static double time_format(void (*format)(int, char[4]), const int *floors, int n_floors)
+{
+    long long start = mono_ns();
+    int sum = 0;
+    char out[4];
+    for (int i = 0; i < BENCH_CALLS; ++i)
+    {
+        format(floors[i % n_floors], out);
+        sum += out[0];
+    }
+    g_sink = sum;
+    return (double)(mono_ns() - start) / BENCH_CALLS;
+}
+
+int main(void)
+{
+    int bad = check();
+    if (bad)
+    {
+        fprintf(stderr, "%d mismatches against strtol/snprintf\n", bad);
+        return 1;
+    }
+    printf("Results match strtol/snprintf\n");
+
+    // Every valid floor, B99 to 999, in a shuffled order
+    enum { N_FLOORS = 99 + 999 };
+    static int floors[N_FLOORS];
+    static char names[N_FLOORS][4];
+    int n = 0;
+    for (int floor = -99; floor <= 999; ++floor)
+    {
+        if (floor != 0)
+        {
+            floors[n++] = floor;
+        }
+    }
+    srand(1);
+    for (int i = N_FLOORS - 1; i > 0; --i)
+    {
+        int j = rand() % (i + 1);
+        int t = floors[i];
+        floors[i] = floors[j];
+        floors[j] = t;
+    }
+    for (int i = 0; i < N_FLOORS; ++i)
+    {
+        index_snprintf(floors[i], names[i]);
+    }
+
+    printf("%-20s %10s %10s\n", "ns per call", "library", "reference");
+    double parse_lib = time_parse(floor_num_handler, names, N_FLOORS);
+    double parse_ref = time_parse(floor_num_strtol, names, N_FLOORS);
+    printf("%-20s %10.2f %10.2f\n", "parse", parse_lib, parse_ref);
+    double format_lib = time_format(index_handler, floors, N_FLOORS);
+    double format_ref = time_format(index_snprintf, floors, N_FLOORS);
+    printf("%-20s %10.2f %10.2f\n", "format", format_lib, format_ref);
+    return 0;
+}
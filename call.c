@@ -7,6 +7,9 @@
 #endif
 
 #include "shared.h"
+#include "config.h"
+#include "tcp_util.h"
+#include "parse_util.h"
 
 #include <arpa/inet.h>
 #include <netinet/in.h>
@@ -19,205 +22,33 @@
 #include <string.h>
 
 //                  Network Information                 //
-// The TCP-IP Server for the car runs on Port 3000
-// or 127.0.0.1
+// Calls go to the controller on port 3000 of 127.0.0.1 unless configured
+// otherwise
 #define CTRL_PORT 3000
 #define LOCALHOST "127.0.0.1"
 
-//                  TCP Helpers                 //
-static ssize_t write_all(int fd, const void* buf, size_t n)
-{
-    // Point to the current position in the buffer
-    // and track bytes left to write
-    const unsigned char* p = (const unsigned char*)buf;
-    size_t left = n;
-    // Write until no bytes left to write
-    while (left > 0)
-    {
-        // Track bytes written
-        // and catch errors
-        ssize_t Written = write(fd, p, left);
-        if (Written < 0)
-        {
-            if (errno == EINTR) continue;
-            return -1;
-        }
-        else if (Written == 0)
-        {
-            return -1;
-        }
-        // Shift the buffer pointer and decrease count
-        p += Written;
-        left -= (size_t)Written;
-    }
-    // Return total bytes written
-    return (ssize_t)n;
-}
-
-static ssize_t read_all(int fd, void* buf, size_t n)
-{
-    // Point to the current position in the buffer
-    // and track bytes left to read
-    unsigned char* p = (unsigned char*)buf;
-    size_t left = n;
-    // Read until no bytes left to read
-    while (left > 0)
-    {
-        // Track bytes read and catch errors
-        ssize_t Read = read(fd, p, left);
-        if (Read < 0)
-        {
-            if (errno == EINTR) continue;
-            return -1;
-        }
-        else if (Read == 0)
-        {
-            return -1;
-        }
-        // Shift the buffer pointer and decrease count
-        p += Read;
-        left -= (size_t)Read;
-    }
-    // Return total bytes read
-    return (ssize_t)n;
-}
-
-static int send_frame(int fd, const char* s)
-{
-    // Store length of message sent
-    size_t len = strlen(s);
-    // Clamp the message to 16 bits
-    if (len > 0xFFFF)
-    {
-        len = 0xFFFF;
-    }
-    // Convert to network order
-    uint16_t nlen = htons((uint16_t)len);
-    // Send the length of the message first
-    if (write_all(fd, &nlen, sizeof nlen) < 0) 
-    {
-        return -1;
-    }
-    // Send the message second
-    if (write_all(fd, s, len) < 0)
-    {
-        return -1;
-    }
-    // Message sent successfully
-    return 0;
-}
-
-static int receive_frame(int fd, char* buf, size_t capacity)
-{
-    // Create a variable for incoming message length
-    uint16_t hlen;
-
-    // Attempt read of message length
-    if (read_all(fd, &hlen, sizeof hlen) < 0)
-    {
-        return -1;
-    }
-
-    // Revert length from network order
-    size_t len = ntohs(hlen);
-
-    // Check to make sure the incoming message is
-    // smaller than the buffer
-    if (len >= capacity)
-    {
-        // Read what can fit and make room for null terminator
-        size_t keep = capacity - 1;
-        if (read_all(fd, buf, keep) < 0)
-        {
-            return -1;
-        }
-
-        // Store the remainder in a temporary buffer
-        // to read and discard
-        size_t remainder = len - keep;
-        char dump[512];
-
-        while (remainder > 0)
-        {
-            // Attempt read of the remainder
-            size_t chunk = remainder > sizeof dump ? sizeof dump : remainder;
-            if (read_all(fd, dump, chunk) < 0) 
-            {
-                return -1;
-            }
-            remainder -= chunk;
-        }
-
-        buf[capacity - 1] = '\0';
-    }
-    // Othrwise read normally
-    else
-    {
-        if (read_all(fd, buf, len) < 0)
-        {
-            return -1;
-        }
-        buf[len] = '\0';
-    }
-    // Message received successfully
-    return 0;
-}
-
-
-//                  Floor Handlers                  //
-static int floor_num_handler(const char *f, int *out)
-{
-    // Check to ensure that f is valid
-    if (!f || !*f)
-    {
-        return 0;
-    }
-
-    // Handle negative conversions for basement floors (b or B)
-    if (f[0] == 'b' || f[0] == 'B')
-    {
-        // Convert the string to long integer ingoring leading B/b
-        char *end = NULL;
-        long i = strtol(f + 1, &end, 10);
-        // Check to make sure floor has been parsed
-        // and is within 1 to 99
-        if (end == f + 1 || i < 1 || i > 99)
-        {
-            return 0;
-        }
-        // Valid floor is passed to pointer and returns successfully
-        *out = -(int)i;
-        return 1;
-    }
-    // Otherwise handle positive floor numbers
-    else
-    {
-        // Convert the string to long integer
-        char *end = NULL;
-        long i = strtol(f, &end, 10);
-        // Check to make sure floor has been parsed
-        // and is within 1 to 999
-        if (end == f || i < 1 || i > 999)
-        {
-            return 0;
-        }
-        // Valid floor is passed to pointer and returns successfully
-        *out = (int)i;
-        return 1;
-    }
-}
-
 int main(int argc, char* argv[]) 
 {
-    if (argc != 3) 
-    {
-        fprintf(stderr, "Usage: %s {source floor} {destination floor}\n", argv[0]);
+    // Options, settable on the command line or in a --config file
+    const char* host = LOCALHOST;
+    int port = CTRL_PORT;
+    net_config_t net = NET_CONFIG_DEFAULT;
+    config_option_t opts[] = {
+        {"host", 0, CONFIG_STRING, &host, NULL, 0, 0, 0, "controller address"},
+        {"port", 0, CONFIG_INT, &port, NULL, 0, 1, NET_PORT_MAX, "controller port"},
+        NET_CONFIG_OPTIONS(net),
+    };
+    int n_opts = (int)(sizeof opts / sizeof opts[0]);
+    char* args[2];
+    if (config_parse(opts, n_opts, argc, argv, args, 2) != 2)
+    {
+        config_usage(stderr, argv[0], "{source floor} {destination floor}", opts, n_opts);
         return 1;
     }
 
     // Map inputs
-    const char* src_floor = argv[1];
-    const char* dst_floor = argv[2];
+    const char* src_floor = args[0];
+    const char* dst_floor = args[1];
 
     int src_floor_int = 0, dst_floor_int = 0;
 
@@ -234,29 +65,10 @@ int main(int argc, char* argv[])
         return 0;
     }
 
-    // Initialise the socket to IPv4
-    int s = socket(AF_INET, SOCK_STREAM, 0);
-    if (s == -1)
-    {
-        printf("Unable to connect to elevator system.\n");
-        return 0;
-    }
-
-    // Initialise network address
-    struct sockaddr_in addr;
-    memset(&addr, 0, sizeof addr);
-    addr.sin_family = AF_INET;
-    addr.sin_port = htons(CTRL_PORT);
-    if (inet_pton(AF_INET, LOCALHOST, &addr.sin_addr) != 1)
-    {
-        close(s);
-        printf("Unable to connect to elevator system.\n");
-        return 0;
-    }
     // Attempt to connect to server
-    if (connect(s, (struct sockaddr*)&addr, sizeof addr) == -1)
+    int s = net_connect(&net, host, port, 0);
+    if (s == -1)
     {
-        close(s);
         printf("Unable to connect to elevator system.\n");
         return 0;
     }
@@ -282,8 +94,19 @@ int main(int argc, char* argv[])
     if (strncmp(rx_buf, "CAR ", 4) == 0)
     {
         char name[32] = {0};
-        (void)sscanf(rx_buf + 4, "%31s", name);
+        long eta_ms = -1;
+        // The controller appends its estimated arrival time in ms
+        int fields = sscanf(rx_buf + 4, "%31s %ld", name, &eta_ms);
         printf("Car %s is arriving.\n", name);
+        if (fields == 2 && eta_ms >= 0)
+        {
+            printf("Estimated arrival in %.1f seconds.\n", (double)eta_ms / 1000.0);
+        }
+    }
+    // Check if the controller shed the call under load
+    else if (strcmp(rx_buf, "BUSY") == 0)
+    {
+        printf("The elevator system is busy, please try again.\n");
     }
     else
     {
@@ -3,8 +3,18 @@
 #ifndef _POSIX_C_SOURCE
 #define _POSIX_C_SOURCE 200809L
 #endif
+// syscall() for the futex helpers in shm_sync.h
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif
 
 #include "shared.h"
+#include "shm_sync.h"
+#include "config.h"
+#include "log.h"
+#include "tcp_util.h"
+#include "parse_util.h"
+#include "time_util.h"
 
 #include <sys/mman.h>
 #include <pthread.h>
@@ -22,8 +32,8 @@
 #include <time.h>
 
 //                  Network Information                 //
-// The TCP-IP Server for the car runs on Port 3000
-// or 127.0.0.1
+// The car connects to the controller on port 3000 of 127.0.0.1 unless
+// configured otherwise
 #define CTRL_PORT 3000
 #define LOCALHOST "127.0.0.1"
 
@@ -31,12 +41,13 @@
 static void *tcp_receive_thread(void *arg);
 static void *tcp_transmit_thread(void *arg);
 static void *tcp_thread(void *arg);
+static void *heartbeat_thread(void *arg);
 
 
 //                  Macros                  //
-#define CAR_LOCK(shm)   pthread_mutex_lock(&(shm)->mutex)
+#define CAR_LOCK(shm)   shm_lock(shm)
 #define CAR_UNLOCK(shm) pthread_mutex_unlock(&(shm)->mutex)
-#define CAR_NOTIFY(shm) pthread_cond_broadcast(&(shm)->cond)
+#define CAR_NOTIFY(shm, topics) shm_notify((shm), (topics))
 
 //                  Global Variables                    //
 
@@ -50,6 +61,23 @@ static unsigned g_delay_ms = 1000;
 static char g_highest_floor[4];
 static char g_lowest_floor[4];
 
+// Controller ports, the car's zone controller first then an optional hot
+// standby (0 if none), and the index of the one last connected to
+static int g_ctrl_ports[2] = {CTRL_PORT, 0};
+static int g_ctrl_index = 0;
+// Address both controllers run on and the socket settings to connect with
+static const char* g_ctrl_host = LOCALHOST;
+static net_config_t g_net = NET_CONFIG_DEFAULT;
+
+// Heartbeat period, and how stale the safety monitor's heartbeat may get
+// before emergency mode (a longer allowance applies until it first beats)
+static unsigned g_heartbeat_ms = 50;
+static unsigned g_safety_timeout_ms = 500;
+static unsigned g_safety_attach_ms = 3000;
+// Least severe level logged and whether lines carry a timestamp
+static const char* g_log_level_name = "info";
+static int g_log_stamp = 0;
+
 // Conversions
 static int  g_lowest_floor_int = 0;  
 static int  g_highest_floor_int = 0;
@@ -60,7 +88,7 @@ static int  has_pending = 0;
 
 //                  Status Flags                    //
 static pthread_mutex_t g_tx_mx = PTHREAD_MUTEX_INITIALIZER;
-static pthread_cond_t  g_tx_cv = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t  g_tx_cv;
 
 static int g_tx_flag = 0;
 static volatile sig_atomic_t g_shutdown = 0;
@@ -96,106 +124,14 @@ static void on_SIGINT(int sig)
         // If shared memory is mapped lock the mutex
         CAR_LOCK(g_shm_ptr);
         // Notify all waiting threads
-        pthread_cond_broadcast(&g_shm_ptr->cond);
+        CAR_NOTIFY(g_shm_ptr, SHM_ALL);
         // Unlock the mutex
         CAR_UNLOCK(g_shm_ptr);
     }
 }
 
-//                  Delay Handlers                  //
-
-static void sleep_ms(unsigned ms)
-{
-    // Pauses the thread for a specific delay (ms)
-    struct timespec ts;
-    // Convert whole ms to sec
-    ts.tv_sec = ms / 1000u;
-    // Convert remainder to ns
-    ts.tv_nsec = (long)(ms % 1000u) * 1000000L;
-    // Pause for the specified delay 
-    while (nanosleep(&ts, &ts) == -1 && errno == EINTR)
-    {}
-}
-
-static struct timespec abs_timeout_ms(unsigned ms)
-{
-    struct timespec ts;
-    // Get current time
-    clock_gettime(CLOCK_REALTIME, &ts);
-    // Perform addition of delay to realtime to let system
-    // know absolute time to wake
-    ts.tv_sec += ms / 1000u;
-    // Handle conditions where nanosec exceeds a second
-    ts.tv_nsec += (long)(ms % 1000u) * 1000000L;
-    if (ts.tv_nsec >= 1000000000L)
-    {
-        ts.tv_sec++;
-        ts.tv_nsec -= 1000000000L;
-    }
-    // return absolute time
-    return ts;
-}
-
 //                  Floor Handlers                  //
 
-static int floor_num_handler(const char *f, int *out)
-{
-    // Check to ensure that f is valid
-    if (!f || !*f)
-    {
-        return 0;
-    }
-
-    // Handle negative conversions for basement floors (b or B)
-    if (f[0] == 'b' || f[0] == 'B')
-    {
-        // Convert the string to long integer ingoring leading B/b
-        char *end = NULL;
-        long i = strtol(f + 1, &end, 10);
-        // Check to make sure floor has been parsed
-        // and is within 1 to 99
-        if (end == f + 1 || i < 1 || i > 99)
-        {
-            return 0;
-        }
-        // Valid floor is passed to pointer and returns successfully
-        *out = -(int)i;
-        return 1;
-    }
-    // Otherwise handle positive floor numbers
-    else
-    {
-        // Convert the string to long integer
-        char *end = NULL;
-        long i = strtol(f, &end, 10);
-        // Check to make sure floor has been parsed
-        // and is within 1 to 999
-        if (end == f || i < 1 || i > 999)
-        {
-            return 0;
-        }
-        // Valid floor is passed to pointer and returns successfully
-        *out = (int)i;
-        return 1;
-    }
-}
-
-static void index_handler(int index, char out[4])
-{
-    // Checks if a floor is negative based on the index
-    if (index < 0)
-    {
-        // If it is negative then the string should
-        // be formatted with a leading B
-        snprintf(out, 4, "B%d", -index);
-    }
-    else 
-    {
-        // Otherwise format as a standard number
-        snprintf(out, 4, "%d", index);
-    }
-}
-
 static int floor_validator(int f)
 {
     // If the input floor is lower than the min floor
@@ -248,146 +184,6 @@ static int at_destination(void)
     return s;
 }
 
-//                  TCP Helpers                 //
-
-static ssize_t write_all(int fd, const void* buf, size_t n)
-{
-    // Point to the current position in the buffer
-    // and track bytes left to write
-    const unsigned char* p = (const unsigned char*)buf;
-    size_t left = n;
-    // Write until no bytes left to write
-    while (left > 0)
-    {
-        // Track bytes written
-        // and catch errors
-        ssize_t Written = write(fd, p, left);
-        if (Written < 0)
-        {
-            if (errno == EINTR) continue;
-            return -1;
-        }
-        else if (Written == 0)
-        {
-            return -1;
-        }
-        // Shift the buffer pointer and decrease count
-        p += Written;
-        left -= (size_t)Written;
-    }
-    // Return total bytes written
-    return (ssize_t)n;
-}
-
-static ssize_t read_all(int fd, void* buf, size_t n)
-{
-    // Point to the current position in the buffer
-    // and track bytes left to read
-    unsigned char* p = (unsigned char*)buf;
-    size_t left = n;
-    // Read until no bytes left to read
-    while (left > 0)
-    {
-        // Track bytes read and catch errors
-        ssize_t Read = read(fd, p, left);
-        if (Read < 0)
-        {
-            if (errno == EINTR) continue;
-            return -1;
-        }
-        else if (Read == 0)
-        {
-            return -1;
-        }
-        // Shift the buffer pointer and decrease count
-        p += Read;
-        left -= (size_t)Read;
-    }
-    // Return total bytes read
-    return (ssize_t)n;
-}
-
-static int send_frame(int fd, const char* s)
-{
-    // Store length of message sent
-    size_t len = strlen(s);
-    // Clamp the message to 16 bits
-    if (len > 0xFFFF)
-    {
-        len = 0xFFFF;
-    }
-    // Convert to network order
-    uint16_t nlen = htons((uint16_t)len);
-    // Send the length of the message first
-    if (write_all(fd, &nlen, sizeof nlen) < 0) 
-    {
-        return -1;
-    }
-    // Send the message second
-    if (write_all(fd, s, len) < 0)
-    {
-        return -1;
-    }
-    // Message sent successfully
-    return 0;
-}
-
-static int receive_frame(int fd, char* buf, size_t capacity)
-{
-    // Create a variable for incoming message length
-    uint16_t hlen;
-
-    // Attempt read of message length
-    if (read_all(fd, &hlen, sizeof hlen) < 0)
-    {
-        return -1;
-    }
-
-    // Revert length from network order
-    size_t len = ntohs(hlen);
-
-    // Check to make sure the incoming message is
-    // smaller than the buffer
-    if (len >= capacity)
-    {
-        // Read what can fit and make room for null terminator
-        size_t keep = capacity - 1;
-        if (read_all(fd, buf, keep) < 0)
-        {
-            return -1;
-        }
-
-        // Store the remainder in a temporary buffer
-        // to read and discard
-        size_t remainder = len - keep;
-        char dump[512];
-
-        while (remainder > 0)
-        {
-            // Attempt read of the remainder
-            size_t chunk = remainder > sizeof dump ? sizeof dump : remainder;
-            if (read_all(fd, dump, chunk) < 0) 
-            {
-                return -1;
-            }
-            remainder -= chunk;
-        }
-
-        buf[capacity - 1] = '\0';
-    }
-    // Othrwise read normally
-    else
-    {
-        if (read_all(fd, buf, len) < 0)
-        {
-            return -1;
-        }
-        buf[len] = '\0';
-    }
-    // Message received successfully
-    return 0;
-}
-
 //                  Status Handlers                  //
 
 static int fetch_status(const char* status)
@@ -436,7 +232,7 @@ static void status_handler(const char* status_update, unsigned delay_ms, char ou
     // Copy and update the new status
     strcpy(g_shm_ptr->status, status_update);
     // Notify the system of status change
-    CAR_NOTIFY(g_shm_ptr);
+    CAR_NOTIFY(g_shm_ptr, SHM_DOORS);
     // Unlock the mutex before delay to ensure mutex is not held
     CAR_UNLOCK(g_shm_ptr);
     // Flag status change
@@ -467,7 +263,7 @@ static void open_status_handler(const char* status_update, unsigned delay_ms, ch
     // Copy and update the new status
     strcpy(g_shm_ptr->status, status_update); 
     // Notify the system of status change 
-    CAR_NOTIFY(g_shm_ptr);
+    CAR_NOTIFY(g_shm_ptr, SHM_DOORS);
     // Unlock the mutex to flag status change
     CAR_UNLOCK(g_shm_ptr);
     // Flag status change
@@ -490,7 +286,7 @@ static void open_status_handler(const char* status_update, unsigned delay_ms, ch
             continue;
         }
         // Check for timeout
-        int err = pthread_cond_timedwait(&g_shm_ptr->cond, &g_shm_ptr->mutex, &open_window);
+        int err = shm_wait(g_shm_ptr, SHM_BUTTONS | SHM_MODES, &open_window);
         if (err == ETIMEDOUT)
         {
             break;
@@ -507,7 +303,7 @@ static void open_status_handler(const char* status_update, unsigned delay_ms, ch
     strcpy(g_shm_ptr->status, "Closing");
 
     // Notify the system of status change
-    CAR_NOTIFY(g_shm_ptr);
+    CAR_NOTIFY(g_shm_ptr, SHM_DOORS);
     // Unlock the mutex to raise status flag and not hold mutex during delay
     CAR_UNLOCK(g_shm_ptr);
     flag_status();
@@ -521,7 +317,7 @@ static void open_status_handler(const char* status_update, unsigned delay_ms, ch
     if (strcmp(g_shm_ptr->status, "Closing") == 0)
     {
         strcpy(g_shm_ptr->status, "Closed");
-        CAR_NOTIFY(g_shm_ptr);
+        CAR_NOTIFY(g_shm_ptr, SHM_DOORS);
     }
     // Copy current status into output and add null terminator
     strncpy(output, g_shm_ptr->status, sizeof g_shm_ptr->status - 1);
@@ -538,7 +334,7 @@ static void to_close(void)
     // Copy and update status to Closed
     strcpy(g_shm_ptr->status, "Closed");
     // Notify the system of status change
-    CAR_NOTIFY(g_shm_ptr);
+    CAR_NOTIFY(g_shm_ptr, SHM_DOORS);
     // Unlock mutex and flag status change
     CAR_UNLOCK(g_shm_ptr);
     flag_status();
@@ -577,7 +373,7 @@ static void exists_pending(void)
         has_pending = 0;
         pending_floor[0] = '\0';
         // Notify system of status change
-        CAR_NOTIFY(g_shm_ptr);
+        CAR_NOTIFY(g_shm_ptr, SHM_MOTION);
     }
     // Unlock mutex and flag status change
     CAR_UNLOCK(g_shm_ptr);
@@ -606,10 +402,11 @@ static void move_one_floor(unsigned delay_ms)
         next = floor_validator(next);
         // Convert next floor back to string and update current floor
         index_handler(next, g_shm_ptr->current_floor);
+        LOG_DEBUG("Car %s at floor %s", g_car_name, g_shm_ptr->current_floor);
         // Update status to Closed and notify system of
         // changed floor
         strcpy(g_shm_ptr->status, "Closed");
-        CAR_NOTIFY(g_shm_ptr);
+        CAR_NOTIFY(g_shm_ptr, SHM_MOTION | SHM_DOORS);
     }
     // Unlock mutex and flag status change
     CAR_UNLOCK(g_shm_ptr);
@@ -643,7 +440,7 @@ static void service_between(unsigned delay_ms)
         strncpy(g_shm_ptr->destination_floor, g_shm_ptr->current_floor, sizeof g_shm_ptr->destination_floor - 1);
         g_shm_ptr->destination_floor[sizeof g_shm_ptr->destination_floor - 1] = '\0';
         // Notify system of status change
-        CAR_NOTIFY(g_shm_ptr);
+        CAR_NOTIFY(g_shm_ptr, SHM_MOTION);
         CAR_UNLOCK(g_shm_ptr);
         return;
     }
@@ -728,7 +525,7 @@ static void *tcp_receive_thread(void *arg)
                 strncpy(pending_floor, floor, sizeof pending_floor - 1);
                 pending_floor[sizeof pending_floor - 1] = '\0';
                 has_pending = 1;
-                CAR_NOTIFY(g_shm_ptr);
+                CAR_NOTIFY(g_shm_ptr, SHM_MOTION);
                 CAR_UNLOCK(g_shm_ptr);
             }
             // Otherwise set the destination floor directly
@@ -737,12 +534,16 @@ static void *tcp_receive_thread(void *arg)
                 CAR_LOCK(g_shm_ptr);
                 strncpy(g_shm_ptr->destination_floor, floor, sizeof g_shm_ptr->destination_floor - 1);
                 g_shm_ptr->destination_floor[sizeof g_shm_ptr->destination_floor - 1] = '\0';
-                CAR_NOTIFY(g_shm_ptr);
+                CAR_NOTIFY(g_shm_ptr, SHM_MOTION);
                 CAR_UNLOCK(g_shm_ptr);
                 flag_status();
             }
         }
     }
+    // Wake the transmit thread so it fails on the closed socket and the
+    // car reconnects without waiting for its next status change
+    shutdown(s, SHUT_RDWR);
+    flag_status();
     // Error or shutdown
     return NULL;
 }
@@ -769,9 +570,7 @@ static void *tcp_transmit_thread(void *arg)
         // Wait for either status flag or timeout
         while (!g_tx_flag)
         {
-            
-            pthread_cond_timedwait(&g_tx_cv, &g_tx_mx, &transmit_timeout);
-            if (g_shutdown)
+            if (pthread_cond_timedwait(&g_tx_cv, &g_tx_mx, &transmit_timeout) == ETIMEDOUT || g_shutdown)
             {
                 break;
             }
@@ -794,38 +593,9 @@ static void *tcp_transmit_thread(void *arg)
             {
                 break;
             }
-            // Reset transmit timeout
-            transmit_timeout = abs_timeout_ms(g_delay_ms);
-        }
-        // Check for safety system transmit timeout
-        struct timespec now;
-        clock_gettime(CLOCK_REALTIME, &now);
-        // If timeout has occurred increment safety system counter
-        if ((now.tv_sec > transmit_timeout.tv_sec) || (now.tv_sec == transmit_timeout.tv_sec && now.tv_nsec >= transmit_timeout.tv_nsec))
-        {
-            
-            int val;
-            CAR_LOCK(g_shm_ptr);
-            val = (int)g_shm_ptr->safety_system + 1;
-            g_shm_ptr->safety_system = (uint8_t)val;
-            CAR_NOTIFY(g_shm_ptr);
-            CAR_UNLOCK(g_shm_ptr);
-
-            // If safety system has timed out 3 times enter emergency mode
-            if (val >= 3)
-            {
-                // Notify system of emergency mode
-                fprintf(stdout, "Safety system disconnected! Entering emergency mode.\n");
-                CAR_LOCK(g_shm_ptr);
-                g_shm_ptr->emergency_mode = 1;
-                CAR_NOTIFY(g_shm_ptr);
-                CAR_UNLOCK(g_shm_ptr);
-                (void)send_frame(s, "EMERGENCY");
-                break;
-            }
-            // Reset  the transmit timeout
-            transmit_timeout = abs_timeout_ms(g_delay_ms);
         }
+        // Re-arm the periodic mode check; liveness is the heartbeat thread's job
+        transmit_timeout = abs_timeout_ms(g_delay_ms);
         // Lock the mutex to check for service or emergency mode
         CAR_LOCK(g_shm_ptr);
         int service_mode  = (g_shm_ptr->individual_service_mode != 0);
@@ -844,6 +614,8 @@ static void *tcp_transmit_thread(void *arg)
         }
 
     }
+    // Unblock the receive thread
+    shutdown(s, SHUT_RDWR);
     // Error or shutdown
     return NULL;
 }
@@ -889,24 +661,27 @@ static void *tcp_thread(void *arg)
             continue;
         }
 
-        // Initialise the socket to IPv4
-        int s = socket(AF_INET, SOCK_STREAM, 0);
-        if (s == -1)
+        // Try the controller last connected to, then the other one, so
+        // failing over to the standby costs a connect rather than a delay
+        int s = -1;
+        for (int k = 0; k < 2 && s == -1; ++k)
         {
-            sleep_ms(g_delay_ms);
-            continue;
+            int index = (g_ctrl_index + k) % 2;
+            if (g_ctrl_ports[index] == 0)
+            {
+                continue;
+            }
+            // Attempt to connect to server
+            s = net_connect(&g_net, g_ctrl_host, g_ctrl_ports[index], 0);
+            if (s == -1)
+            {
+                continue;
+            }
+            g_ctrl_index = index;
         }
-        // Initialise network address
-        struct sockaddr_in addr;
-        memset(&addr, 0, sizeof addr);
-        addr.sin_family = AF_INET;
-        addr.sin_port = htons(CTRL_PORT);
-        inet_pton(AF_INET, LOCALHOST, &addr.sin_addr);
-
-        // Attempt to connect to server
-        if (connect(s, (struct sockaddr*)&addr, sizeof addr) == -1)
+        // Wait before trying again if neither controller is up
+        if (s == -1)
         {
-            close(s);
             sleep_ms(g_delay_ms);
             continue;
         }
@@ -948,27 +723,106 @@ static void *tcp_thread(void *arg)
     return NULL;
 }
 
+//                  Heartbeat                   //
+
+static void *heartbeat_thread(void *arg)
+{
+    (void)arg;
+    // Safety monitor heartbeats newer than this come from a running monitor
+    uint64_t started_ns = shm_now_ns();
+    int lost = 0;
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    while (!g_shutdown)
+    {
+        // Tell the safety monitor the car is alive
+        shm_beat(&g_shm_ptr->car_beat_ns);
+
+        // Allow the monitor longer to start than to answer once running
+        uint64_t beat_ns = atomic_load_explicit((_Atomic uint64_t*)&g_shm_ptr->safety_beat_ns, memory_order_acquire);
+        unsigned limit_ms = beat_ns > started_ns ? g_safety_timeout_ms : g_safety_attach_ms;
+        if (shm_beat_age_ms(&g_shm_ptr->safety_beat_ns) > limit_ms)
+        {
+            if (!lost)
+            {
+                lost = 1;
+                LOG_WARN("Safety system disconnected! Entering emergency mode.");
+                CAR_LOCK(g_shm_ptr);
+                g_shm_ptr->safety_system = 0;
+                g_shm_ptr->emergency_mode = 1;
+                CAR_NOTIFY(g_shm_ptr, SHM_MODES);
+                CAR_UNLOCK(g_shm_ptr);
+                // Wake the transmit thread to report the emergency
+                flag_status();
+            }
+        }
+        else
+        {
+            lost = 0;
+        }
+
+        // Sleep to the next period on an absolute deadline, so the beat does not drift
+        next.tv_nsec += (long)g_heartbeat_ms * 1000000L;
+        while (next.tv_nsec >= 1000000000L)
+        {
+            next.tv_sec++;
+            next.tv_nsec -= 1000000000L;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+    }
+    return NULL;
+}
+
 //                  MAIN                    //
 
 int main(int argc, char *argv[])
 {
-    if (argc != 5)
+    // Options, settable on the command line or in a --config file
+    config_option_t opts[] = {
+        {"host", 0, CONFIG_STRING, &g_ctrl_host, NULL, 0, 0, 0, "controller address"},
+        {"port", 0, CONFIG_INT, &g_ctrl_ports[0], NULL, 0, 1, NET_PORT_MAX, "controller port"},
+        {"standby-port", 0, CONFIG_INT, &g_ctrl_ports[1], NULL, 0, 0, NET_PORT_MAX, "hot standby controller port"},
+        {"heartbeat-ms", 0, CONFIG_UNSIGNED, &g_heartbeat_ms, NULL, 0, 0, 0, "heartbeat period"},
+        {"safety-timeout-ms", 0, CONFIG_UNSIGNED, &g_safety_timeout_ms, NULL, 0, 0, 0, "safety monitor heartbeat age that triggers emergency mode"},
+        {"safety-attach-ms", 0, CONFIG_UNSIGNED, &g_safety_attach_ms, NULL, 0, 0, 0, "time allowed for the safety monitor to start"},
+        NET_CONFIG_OPTIONS(g_net),
+        LOG_CONFIG_OPTIONS(g_log_level_name, g_log_stamp),
+    };
+    int n_opts = (int)(sizeof opts / sizeof opts[0]);
+    char* args[5];
+    int n_args = config_parse(opts, n_opts, argc, argv, args, 5);
+    if (n_args != 4 && n_args != 5)
+    {
+        config_usage(stderr, argv[0], "{name} {lowest_floor} {highest_floor} {delay} [port[,standby_port]]", opts, n_opts);
+        return 1;
+    }
+
+    // Log through the background flusher from here on
+    log_level_t log_level;
+    if (log_level_parse(g_log_level_name, &log_level) == -1 || log_init(log_level, g_log_stamp) == -1)
     {
-        fprintf(stderr, "Usage: %s {name} {lowest_floor} {highest_floor} {delay}\n", argv[0]);
+        fprintf(stderr, "Invalid log level: %s\n", g_log_level_name);
         return 1;
     }
 
     // Map inputs
-    strncpy(g_car_name, argv[1], sizeof g_car_name - 1);
+    strncpy(g_car_name, args[0], sizeof g_car_name - 1);
     g_car_name[sizeof g_car_name - 1] = '\0';
 
-    strncpy(g_lowest_floor, argv[2], sizeof g_lowest_floor - 1);
+    strncpy(g_lowest_floor, args[1], sizeof g_lowest_floor - 1);
     g_lowest_floor[sizeof g_lowest_floor - 1] = '\0';
 
-    strncpy(g_highest_floor, argv[3], sizeof g_highest_floor - 1);
+    strncpy(g_highest_floor, args[2], sizeof g_highest_floor - 1);
     g_highest_floor[sizeof g_highest_floor - 1] = '\0';
 
-    g_delay_ms = (unsigned)strtoul(argv[4], NULL, 10);
+    g_delay_ms = (unsigned)strtoul(args[3], NULL, 10);
+
+    // Connect to the given controller, failing over to a standby if one is given
+    if ((n_args == 5 && sscanf(args[4], "%d,%d", &g_ctrl_ports[0], &g_ctrl_ports[1]) < 1) || g_ctrl_ports[0] <= 0)
+    {
+        fprintf(stderr, "Invalid controller port.\n");
+        return 1;
+    }
 
     // Validate floor inputs
     if (!floor_num_handler(g_highest_floor, &g_highest_floor_int) ||
@@ -978,6 +832,11 @@ int main(int argc, char *argv[])
         fprintf(stderr, "Invalid floor range.\n");
         return 1;
     }
+    if (g_heartbeat_ms == 0 || g_heartbeat_ms >= g_safety_timeout_ms)
+    {
+        fprintf(stderr, "Heartbeat period must be non-zero and below the safety timeout.\n");
+        return 1;
+    }
     // Signal handling 
     signal(SIGPIPE, SIG_IGN);
     struct sigaction sa;
@@ -1020,11 +879,17 @@ int main(int argc, char *argv[])
 
     pthread_mutexattr_init(&mutex_var);
     pthread_mutexattr_setpshared(&mutex_var, PTHREAD_PROCESS_SHARED);
+    // A process killed while holding the mutex must not wedge the car
+    pthread_mutexattr_setrobust(&mutex_var, PTHREAD_MUTEX_ROBUST);
     pthread_mutex_init(&g_shm_ptr->mutex, &mutex_var);
+    pthread_mutexattr_destroy(&mutex_var);
 
+    // Timed waits on the transmit condition use the monotonic clock, like
+    // the futex waits on the shared memory
     pthread_condattr_init(&cond_var);
-    pthread_condattr_setpshared(&cond_var, PTHREAD_PROCESS_SHARED);
-    pthread_cond_init(&g_shm_ptr->cond, &cond_var);
+    pthread_condattr_setclock(&cond_var, CLOCK_MONOTONIC);
+    pthread_cond_init(&g_tx_cv, &cond_var);
+    pthread_condattr_destroy(&cond_var);
 
     strcpy(g_shm_ptr->current_floor, g_lowest_floor);
     strcpy(g_shm_ptr->destination_floor, g_lowest_floor);
@@ -1039,6 +904,23 @@ int main(int argc, char *argv[])
     g_shm_ptr->emergency_stop = 0;
     g_shm_ptr->individual_service_mode = 0;
     g_shm_ptr->emergency_mode = 0;
+    // Drop events left by an earlier car of the same name
+    memset(&g_shm_ptr->safety_events, 0, sizeof g_shm_ptr->safety_events);
+    // Start the safety monitor's allowance from now
+    shm_beat(&g_shm_ptr->car_beat_ns);
+    shm_beat(&g_shm_ptr->safety_beat_ns);
+
+    // Start heartbeat thread; without it a dead safety monitor would go
+    // unnoticed, so the car does not run
+    pthread_t hb_tid;
+    if (pthread_create(&hb_tid, NULL, heartbeat_thread, NULL) != 0)
+    {
+        perror("pthread_create");
+        pthread_mutex_destroy(&g_shm_ptr->mutex);
+        munmap(g_shm_ptr, sizeof(car_shared_mem));
+        shm_unlink(g_shm_name);
+        return 1;
+    }
 
     // Start TCP thread and detatch
     pthread_t tcp_tid;
@@ -1060,7 +942,7 @@ int main(int argc, char *argv[])
             && strcmp(g_shm_ptr->current_floor, g_shm_ptr->destination_floor) == 0)
         {
             struct timespec timeout = abs_timeout_ms(200);
-            pthread_cond_timedwait(&g_shm_ptr->cond, &g_shm_ptr->mutex, &timeout);
+            shm_wait(g_shm_ptr, SHM_MOTION | SHM_BUTTONS | SHM_MODES, &timeout);
         }
 
         // Unlock mutex to check what changed
@@ -1098,7 +980,7 @@ int main(int argc, char *argv[])
                     {
                         CAR_LOCK(g_shm_ptr);
                         strcpy(g_shm_ptr->status, "Open");
-                        CAR_NOTIFY(g_shm_ptr);
+                        CAR_NOTIFY(g_shm_ptr, SHM_DOORS);
                         CAR_UNLOCK(g_shm_ptr);
                         flag_status();
                     }
@@ -1118,7 +1000,7 @@ int main(int argc, char *argv[])
             // Lock mutex to wait before next check
             CAR_LOCK(g_shm_ptr);
             struct timespec ts = abs_timeout_ms(100);
-            pthread_cond_timedwait(&g_shm_ptr->cond, &g_shm_ptr->mutex, &ts);
+            shm_wait(g_shm_ptr, SHM_MOTION | SHM_BUTTONS | SHM_MODES, &ts);
             CAR_UNLOCK(g_shm_ptr);
             continue;
         }
@@ -1145,7 +1027,7 @@ int main(int argc, char *argv[])
                     {
                         CAR_LOCK(g_shm_ptr);
                         strcpy(g_shm_ptr->status, "Open");
-                        CAR_NOTIFY(g_shm_ptr);
+                        CAR_NOTIFY(g_shm_ptr, SHM_DOORS);
                         CAR_UNLOCK(g_shm_ptr);
                         flag_status();
                     }
@@ -1164,7 +1046,7 @@ int main(int argc, char *argv[])
                     {
                         CAR_LOCK(g_shm_ptr);
                         strcpy(g_shm_ptr->status, "Closed");
-                        CAR_NOTIFY(g_shm_ptr);
+                        CAR_NOTIFY(g_shm_ptr, SHM_DOORS);
                         CAR_UNLOCK(g_shm_ptr);
                         flag_status();
                     }
@@ -1174,7 +1056,7 @@ int main(int argc, char *argv[])
                 {
                     CAR_LOCK(g_shm_ptr);
                     strcpy(g_shm_ptr->status, "Closed");
-                    CAR_NOTIFY(g_shm_ptr);
+                    CAR_NOTIFY(g_shm_ptr, SHM_DOORS);
                     CAR_UNLOCK(g_shm_ptr);
                     flag_status();
                 }
@@ -1183,7 +1065,7 @@ int main(int argc, char *argv[])
             CAR_LOCK(g_shm_ptr);
             // Wait before next check
             struct timespec ts = abs_timeout_ms(100);
-            pthread_cond_timedwait(&g_shm_ptr->cond, &g_shm_ptr->mutex, &ts);
+            shm_wait(g_shm_ptr, SHM_MOTION | SHM_BUTTONS | SHM_MODES, &ts);
             CAR_UNLOCK(g_shm_ptr);
             continue;
         }
@@ -1263,15 +1145,16 @@ int main(int argc, char *argv[])
         CAR_LOCK(g_shm_ptr);
         // Wait before next check
         struct timespec ts = abs_timeout_ms(50);
-        pthread_cond_timedwait(&g_shm_ptr->cond, &g_shm_ptr->mutex, &ts);
+        shm_wait(g_shm_ptr, SHM_ALL, &ts);
         CAR_UNLOCK(g_shm_ptr);
     }
+    // Wait for the heartbeat to stop touching the shared memory
+    pthread_join(hb_tid, NULL);
     // Handle clean up and shutdown
     if (g_shm_ptr != NULL)
     {
-        // Destroy mutex and condition variable
+        // Destroy mutex
         pthread_mutex_destroy(&g_shm_ptr->mutex);
-        pthread_cond_destroy(&g_shm_ptr->cond);
         // Unmap shared memory
         munmap(g_shm_ptr, sizeof(car_shared_mem));
     }
@@ -0,0 +1,465 @@
+// Author: Alexandros Sacranie
+// Module: Safety Critical Monitor (config.c)
+// Project: Distributed Elevator Control System
+
+/* Runtime configuration
+
+    Every program describes its settings in a table of config_option_t. A
+    setting can come from a config file given with --config=path, holding
+    "name = value" lines, and from the command line as --name=value (or the
+    legacy single-letter flag). The file is applied first so the command line
+    always wins. Integer settings carry the range the program accepts, and
+    a value outside it is refused with the file line it came from.
+*/
+
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+// SO_REUSEPORT, TCP_KEEPIDLE and thread affinity are Linux extensions
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "config.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+//                  Option Parsing                  //
+
+static const config_option_t* find_option(const config_option_t* opts, int n_opts, const char* name, size_t len)
+{
+    // Match the full option name
+    for (int i = 0; i < n_opts; ++i)
+    {
+        if (strlen(opts[i].name) == len && strncmp(opts[i].name, name, len) == 0)
+        {
+            return &opts[i];
+        }
+    }
+    return NULL;
+}
+
+// Check an integer against the option's range; returns 0 if it is within
+static int check_range(const config_option_t* o, long v, const char* value, const char* origin)
+{
+    // An option with no range still has to fit in an int
+    int min = o->min, max = o->max;
+    if (min == 0 && max == 0)
+    {
+        min = INT_MIN;
+        max = INT_MAX;
+    }
+    if (v < min || v > max)
+    {
+        fprintf(stderr, "%s: %s must be between %d and %d: %s\n", origin, o->name, min, max, value);
+        return -1;
+    }
+    return 0;
+}
+
+static int set_option(const config_option_t* o, const char* value, const char* origin)
+{
+    char* end = NULL;
+    // Flags may be given without a value
+    if (!value && o->type != CONFIG_FLAG)
+    {
+        fprintf(stderr, "%s: option %s needs a value\n", origin, o->name);
+        return -1;
+    }
+    switch (o->type)
+    {
+        case CONFIG_INT:
+        {
+            long v = strtol(value, &end, 10);
+            if (end == value || *end != '\0')
+            {
+                break;
+            }
+            if (check_range(o, v, value, origin) == -1)
+            {
+                return -1;
+            }
+            *(int*)o->value = (int)v;
+            return 0;
+        }
+        case CONFIG_UNSIGNED:
+        {
+            unsigned long v = strtoul(value, &end, 10);
+            if (end == value || *end != '\0' || value[0] == '-')
+            {
+                break;
+            }
+            *(unsigned*)o->value = (unsigned)v;
+            return 0;
+        }
+        case CONFIG_STRING:
+        {
+            // Values read from a file do not outlive the line buffer
+            char* copy = strdup(value);
+            if (!copy)
+            {
+                break;
+            }
+            *(const char**)o->value = copy;
+            return 0;
+        }
+        case CONFIG_FLAG:
+        {
+            if (!value || strcmp(value, "1") == 0 || strcmp(value, "yes") == 0 || strcmp(value, "true") == 0)
+            {
+                *(int*)o->value = 1;
+                return 0;
+            }
+            if (strcmp(value, "0") == 0 || strcmp(value, "no") == 0 || strcmp(value, "false") == 0)
+            {
+                *(int*)o->value = 0;
+                return 0;
+            }
+            break;
+        }
+        case CONFIG_INT_LIST:
+        {
+            long v = strtol(value, &end, 10);
+            if (end == value || *end != '\0' || *o->count >= o->capacity)
+            {
+                break;
+            }
+            if (check_range(o, v, value, origin) == -1)
+            {
+                return -1;
+            }
+            ((int*)o->value)[(*o->count)++] = (int)v;
+            return 0;
+        }
+    }
+    // Value could not be parsed or stored
+    fprintf(stderr, "%s: invalid value for %s: %s\n", origin, o->name, value);
+    return -1;
+}
+
+static int load_file(const config_option_t* opts, int n_opts, const char* path)
+{
+    FILE* in = fopen(path, "r");
+    if (!in)
+    {
+        perror(path);
+        return -1;
+    }
+    char line[256];
+    int line_no = 0, err = 0;
+    // Apply one "name = value" setting per line
+    while (!err && fgets(line, sizeof line, in))
+    {
+        line_no++;
+        // Strip comments and trailing whitespace
+        char* hash = strchr(line, '#');
+        if (hash)
+        {
+            *hash = '\0';
+        }
+        size_t len = strlen(line);
+        while (len > 0 && isspace((unsigned char)line[len - 1]))
+        {
+            line[--len] = '\0';
+        }
+        // Skip leading whitespace and blank lines
+        char* name = line;
+        while (isspace((unsigned char)*name))
+        {
+            name++;
+        }
+        if (*name == '\0')
+        {
+            continue;
+        }
+        // Split the name from the value
+        char* eq = strchr(name, '=');
+        char* value = NULL;
+        size_t name_len = eq ? (size_t)(eq - name) : strlen(name);
+        while (name_len > 0 && isspace((unsigned char)name[name_len - 1]))
+        {
+            name_len--;
+        }
+        if (eq)
+        {
+            value = eq + 1;
+            while (isspace((unsigned char)*value))
+            {
+                value++;
+            }
+        }
+        char origin[300];
+        snprintf(origin, sizeof origin, "%s:%d", path, line_no);
+        const config_option_t* o = find_option(opts, n_opts, name, name_len);
+        if (!o)
+        {
+            fprintf(stderr, "%s: unknown option %.*s\n", origin, (int)name_len, name);
+            err = -1;
+        }
+        else
+        {
+            err = set_option(o, value, origin);
+        }
+    }
+    fclose(in);
+    return err;
+}
+
+int config_parse(const config_option_t* opts, int n_opts, int argc, char* argv[],
+                 char* positional[], int max_positional)
+{
+    // Apply the config file first so flags override it
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strncmp(argv[i], "--config=", 9) == 0 && load_file(opts, n_opts, argv[i] + 9) == -1)
+        {
+            return -1;
+        }
+    }
+
+    int n_positional = 0;
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* arg = argv[i];
+        const config_option_t* o = NULL;
+        const char* value = NULL;
+        if (strncmp(arg, "--config=", 9) == 0)
+        {
+            continue;
+        }
+        if (strcmp(arg, "--help") == 0)
+        {
+            return -1;
+        }
+        if (strncmp(arg, "--", 2) == 0)
+        {
+            // Long option, --name or --name=value
+            const char* eq = strchr(arg + 2, '=');
+            size_t len = eq ? (size_t)(eq - (arg + 2)) : strlen(arg + 2);
+            o = find_option(opts, n_opts, arg + 2, len);
+            value = eq ? eq + 1 : NULL;
+        }
+        else if (arg[0] == '-' && arg[1] != '\0' && arg[2] == '\0' && !isdigit((unsigned char)arg[1]))
+        {
+            // Single-letter flag taking the next argument
+            for (int k = 0; k < n_opts && !o; ++k)
+            {
+                if (opts[k].short_name == arg[1])
+                {
+                    o = &opts[k];
+                }
+            }
+            if (o && o->type != CONFIG_FLAG)
+            {
+                value = (i + 1 < argc) ? argv[++i] : NULL;
+            }
+        }
+        else
+        {
+            // Anything else is a positional argument (negative numbers included)
+            if (n_positional == max_positional)
+            {
+                fprintf(stderr, "Unexpected argument: %s\n", arg);
+                return -1;
+            }
+            positional[n_positional++] = argv[i];
+            continue;
+        }
+        if (!o)
+        {
+            fprintf(stderr, "Unknown option: %s\n", arg);
+            return -1;
+        }
+        if (set_option(o, value, "command line") == -1)
+        {
+            return -1;
+        }
+    }
+    // Return number of positional arguments
+    return n_positional;
+}
+
+void config_usage(FILE* out, const char* prog, const char* positional,
+                  const config_option_t* opts, int n_opts)
+{
+    fprintf(out, "Usage: %s [options]%s%s\n", prog, positional ? " " : "", positional ? positional : "");
+    fprintf(out, "  --config=PATH          read \"name = value\" settings from a file\n");
+    // List each option with its legacy flag
+    for (int i = 0; i < n_opts; ++i)
+    {
+        char name[40];
+        snprintf(name, sizeof name, "--%s%s", opts[i].name, opts[i].type == CONFIG_FLAG ? "" : "=N");
+        if (opts[i].type == CONFIG_STRING)
+        {
+            snprintf(name, sizeof name, "--%s=S", opts[i].name);
+        }
+        if (opts[i].short_name)
+        {
+            fprintf(out, "  %-22s (-%c) %s\n", name, opts[i].short_name, opts[i].help);
+        }
+        else
+        {
+            fprintf(out, "  %-22s %s\n", name, opts[i].help);
+        }
+    }
+}
+
+//                  Socket Setup                  //
+
+void net_tune(int fd, const net_config_t* cfg)
+{
+    // Only override buffer sizes that were configured
+    if (cfg->rcvbuf > 0)
+    {
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &cfg->rcvbuf, sizeof cfg->rcvbuf);
+    }
+    if (cfg->sndbuf > 0)
+    {
+        setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &cfg->sndbuf, sizeof cfg->sndbuf);
+    }
+    // Detect dead peers on idle connections
+    if (cfg->keepalive)
+    {
+        int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &on, sizeof on);
+        if (cfg->keepidle_s > 0)
+        {
+            setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, &cfg->keepidle_s, sizeof cfg->keepidle_s);
+        }
+    }
+}
+
+static int make_addr(const char* host, int port, struct sockaddr_in* addr)
+{
+    // Build an IPv4 address from dotted decimal
+    memset(addr, 0, sizeof *addr);
+    addr->sin_family = AF_INET;
+    addr->sin_port = htons((uint16_t)port);
+    return inet_pton(AF_INET, host, &addr->sin_addr) == 1 ? 0 : -1;
+}
+
+int net_listen(const net_config_t* cfg, const char* host, int port)
+{
+    struct sockaddr_in addr;
+    if (make_addr(host, port, &addr) == -1)
+    {
+        return -1;
+    }
+    int s = socket(AF_INET, SOCK_STREAM, 0);
+    if (s == -1)
+    {
+        return -1;
+    }
+    int on = 1;
+    // Allow port reuse directly after termination
+    setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &on, sizeof on);
+    // Let several processes accept on the same port
+    if (cfg->reuseport)
+    {
+        setsockopt(s, SOL_SOCKET, SO_REUSEPORT, &on, sizeof on);
+    }
+    // Accepted sockets inherit buffer sizes and keepalive from the listener
+    net_tune(s, cfg);
+    if (bind(s, (struct sockaddr*)&addr, sizeof addr) == -1 || listen(s, cfg->backlog) == -1)
+    {
+        close(s);
+        return -1;
+    }
+    return s;
+}
+
+static int connect_within(int s, const struct sockaddr_in* addr, int timeout_ms)
+{
+    // Connect without blocking, then wait for the handshake up to the timeout
+    int flags = fcntl(s, F_GETFL);
+    if (flags == -1 || fcntl(s, F_SETFL, flags | O_NONBLOCK) == -1)
+    {
+        return -1;
+    }
+    if (connect(s, (const struct sockaddr*)addr, sizeof *addr) == -1)
+    {
+        if (errno != EINPROGRESS)
+        {
+            return -1;
+        }
+        struct pollfd pfd = {s, POLLOUT, 0};
+        int err = 0;
+        socklen_t len = sizeof err;
+        int ready;
+        while ((ready = poll(&pfd, 1, timeout_ms)) == -1 && errno == EINTR)
+        {
+        }
+        if (ready == 0)
+        {
+            errno = ETIMEDOUT;
+            return -1;
+        }
+        if (ready == -1 || getsockopt(s, SOL_SOCKET, SO_ERROR, &err, &len) == -1)
+        {
+            return -1;
+        }
+        if (err != 0)
+        {
+            errno = err;
+            return -1;
+        }
+    }
+    // Later sends and receives give up after the same timeout
+    struct timeval tv = {timeout_ms / 1000, (timeout_ms % 1000) * 1000};
+    setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof tv);
+    setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof tv);
+    return fcntl(s, F_SETFL, flags);
+}
+
+int net_connect(const net_config_t* cfg, const char* host, int port, int timeout_ms)
+{
+    struct sockaddr_in addr;
+    if (make_addr(host, port, &addr) == -1)
+    {
+        return -1;
+    }
+    int s = socket(AF_INET, SOCK_STREAM, 0);
+    if (s == -1)
+    {
+        return -1;
+    }
+    // Tune before connecting so the window is sized from the handshake
+    net_tune(s, cfg);
+    int rc = timeout_ms > 0 ? connect_within(s, &addr, timeout_ms)
+                            : connect(s, (struct sockaddr*)&addr, sizeof addr);
+    if (rc == -1)
+    {
+        close(s);
+        return -1;
+    }
+    return s;
+}
+
+//                  Thread Placement                  //
+
+int thread_pin_cpu(int cpu)
+{
+    // Spread indices over the CPUs that are online
+    long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n_cpus < 1 || cpu < 0)
+    {
+        return -1;
+    }
+    cpu = (int)(cpu % n_cpus);
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof set, &set) == 0 ? cpu : -1;
+}
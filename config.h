@@ -0,0 +1,92 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <limits.h>
+#include <stdio.h>
+
+// How an option's value is parsed
+typedef enum
+{
+    CONFIG_INT,        // int, decimal
+    CONFIG_UNSIGNED,   // unsigned, decimal
+    CONFIG_STRING,     // const char*, copied
+    CONFIG_FLAG,       // int set to 1 (or 0/1, yes/no, true/false when a value is given)
+    CONFIG_INT_LIST    // int[], appended once per occurrence
+} config_type_t;
+
+// One configurable setting of a program
+typedef struct {
+  const char* name;      // Given as --name=value or "name = value" in a config file
+  char short_name;       // Single-letter flag taking the next argument (0 if none)
+  config_type_t type;    // How the value is parsed
+  void* value;           // Where the value is stored
+  int* count;            // Values stored so far (CONFIG_INT_LIST only)
+  int capacity;          // Capacity of the list (CONFIG_INT_LIST only)
+  int min;               // Least value accepted (CONFIG_INT and CONFIG_INT_LIST)
+  int max;               // Greatest value accepted; 0 and 0 accept any int
+  const char* help;      // One-line description for the usage text
+} config_option_t;
+
+// Socket settings shared by every endpoint
+typedef struct {
+  int backlog;           // Pending connections a listener queues
+  int reuseport;         // 1 sets SO_REUSEPORT so several listeners share a port
+  int rcvbuf;            // SO_RCVBUF in bytes (0 keeps the system default)
+  int sndbuf;            // SO_SNDBUF in bytes (0 keeps the system default)
+  int keepalive;         // 1 enables TCP keepalive
+  int keepidle_s;        // Idle seconds before keepalive probes (0 keeps the default)
+} net_config_t;
+
+// Greatest TCP port number
+#define NET_PORT_MAX 65535
+
+// Greatest keepalive idle time Linux accepts, in seconds
+#define NET_KEEPIDLE_MAX 32767
+
+// Listen backlog used unless configured
+#define NET_DEFAULT_BACKLOG 128
+
+// Initialiser for a net_config_t with default settings
+#define NET_CONFIG_DEFAULT {NET_DEFAULT_BACKLOG, 0, 0, 0, 0, 0}
+
+// Options table entries for the fields of a net_config_t
+#define NET_CONFIG_OPTIONS(cfg) \
+    {"backlog", 0, CONFIG_INT, &(cfg).backlog, NULL, 0, 1, INT_MAX, "listen backlog"}, \
+    {"reuseport", 0, CONFIG_FLAG, &(cfg).reuseport, NULL, 0, 0, 0, "share the listen port with other processes (SO_REUSEPORT)"}, \
+    {"rcvbuf", 0, CONFIG_INT, &(cfg).rcvbuf, NULL, 0, 0, INT_MAX, "socket receive buffer bytes"}, \
+    {"sndbuf", 0, CONFIG_INT, &(cfg).sndbuf, NULL, 0, 0, INT_MAX, "socket send buffer bytes"}, \
+    {"keepalive", 0, CONFIG_FLAG, &(cfg).keepalive, NULL, 0, 0, 0, "enable TCP keepalive"}, \
+    {"keepidle", 0, CONFIG_INT, &(cfg).keepidle_s, NULL, 0, 0, NET_KEEPIDLE_MAX, "idle seconds before keepalive probes"}
+
+// Options table entries for the log level name and the timestamp flag
+#define LOG_CONFIG_OPTIONS(level_name, stamp) \
+    {"log-level", 0, CONFIG_STRING, &(level_name), NULL, 0, 0, 0, "least severe messages logged: debug, info, warn or error"}, \
+    {"log-stamp", 0, CONFIG_FLAG, &(stamp), NULL, 0, 0, 0, "prefix log lines with the time and level"}
+
+// Apply --config=path (file first), then the command line, to the options.
+// Arguments that are not options are collected in positional[] in order.
+// Returns the number of positional arguments, or -1 on an invalid or
+// unknown option (after printing the reason to stderr) or --help.
+int config_parse(const config_option_t* opts, int n_opts, int argc, char* argv[],
+                 char* positional[], int max_positional);
+
+// Print the usage text listing every option
+void config_usage(FILE* out, const char* prog, const char* positional,
+                  const config_option_t* opts, int n_opts);
+
+// Apply buffer and keepalive settings to a socket
+void net_tune(int fd, const net_config_t* cfg);
+
+// Bind and listen on an IPv4 address and port; returns the socket or -1
+int net_listen(const net_config_t* cfg, const char* host, int port);
+
+// Connect to an IPv4 address and port; returns the socket or -1. A nonzero
+// timeout_ms bounds the connect and every later send and receive on the
+// socket; 0 blocks as long as the peer takes.
+int net_connect(const net_config_t* cfg, const char* host, int port, int timeout_ms);
+
+// Pin the calling thread to a CPU, wrapping around the online CPUs.
+// Returns the CPU pinned to, or -1 if the affinity could not be set.
+int thread_pin_cpu(int cpu);
+
+#endif // CONFIG_H
@@ -5,9 +5,25 @@
 #ifndef _POSIX_C_SOURCE
 #define _POSIX_C_SOURCE 200809L
 #endif
+// syscall() for the futex helpers in shm_sync.h
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif
 
 
 #include "shared.h"
+#include "shm_sync.h"
+#include "dispatch.h"
+#include "traffic.h"
+#include "journal.h"
+#include "snapshot.h"
+#include "config.h"
+#include "pool.h"
+#include "admit.h"
+#include "log.h"
+#include "tcp_util.h"
+#include "parse_util.h"
+#include "time_util.h"
 
 #include <sys/mman.h>
 #include <pthread.h>
@@ -23,277 +39,126 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <stdbool.h>
+#include <limits.h>
+#include <time.h>
+#include <sys/time.h>
 
 
 
-//                  Network Information                 //
-// The TCP-IP Server for the controller runs on Port 3000
-// or 127.0.0.1
+// The TCP-IP Server for the controller defaults to port 3000 on every
+// interface; replication and peer zones default to 127.0.0.1
 #define CTRL_PORT 3000
 #define LOCALHOST "127.0.0.1"
+// Most peer controllers a zone can forward calls to
+#define MAX_PEERS 8
+// Most acceptor threads the controller listens with
+#define MAX_ACCEPTORS 64
 
 
 //                  Macros                  //
 #define REGISTRY_LOCK()   pthread_mutex_lock(&g_cars_mtx)
 #define REGISTRY_UNLOCK() pthread_mutex_unlock(&g_cars_mtx)
-#define MAX_CARS 16
-#define MAX_QUEUE 32
+// Registry snapshot period and how long recovered cars have to re-register
+// before their waiting passengers are handed to other cars
+#define SNAPSHOT_PERIOD_MS 100u
+#define RECOVERY_GRACE_MS 10000L
+// How long a pool worker waits for a new connection's first frame
+#define FIRST_FRAME_TIMEOUT_MS 2000
 
 //                  Global Variables and Structures                //
-typedef struct
-{
-    int in_use;
-    int shm_fd;
-    int socket_fd;
-    char name[32];
-    int lowest_floor, highest_floor;
-    int q[MAX_QUEUE];
-    int queue_len;
-    char status[16];
-    char cur_floor[4];
-    char dst_floor[4];
-    car_shared_mem*  shm_ptr;
-} CarID;
 
 static CarID g_cars[MAX_CARS];
 static pthread_mutex_t g_cars_mtx = PTHREAD_MUTEX_INITIALIZER;
 
-//                  TCP Helpers                 //
-
-static ssize_t write_all(int fd, const void* buf, size_t n)
-{
-    // Point to the current position in the buffer
-    // and track bytes left to write
-    const unsigned char* p = (const unsigned char*)buf;
-    size_t left = n;
-    // Write until no bytes left to write
-    while (left > 0)
-    {
-        // Track bytes written
-        // and catch errors
-        ssize_t Written = write(fd, p, left);
-        if (Written < 0)
-        {
-            if (errno == EINTR) continue;
-            return -1;
-        }
-        else if (Written == 0)
-        {
-            return -1;
-        }
-        // Shift the buffer pointer and decrease count
-        p += Written;
-        left -= (size_t)Written;
-    }
-    // Return total bytes written
-    return (ssize_t)n;
-}
-
-static ssize_t read_all(int fd, void* buf, size_t n)
-{
-    // Point to the current position in the buffer
-    // and track bytes left to read
-    unsigned char* p = (unsigned char*)buf;
-    size_t left = n;
-    // Read until no bytes left to read
-    while (left > 0)
-    {
-        // Track bytes read and catch errors
-        ssize_t Read = read(fd, p, left);
-        if (Read < 0)
-        {
-            if (errno == EINTR) continue;
-            return -1;
-        }
-        else if (Read == 0)
-        {
-            return -1;
-        }
-        // Shift the buffer pointer and decrease count
-        p += Read;
-        left -= (size_t)Read;
-    }
-    // Return total bytes read
-    return (ssize_t)n;
-}
-
-static int send_frame(int fd, const char* s)
-{
-    // Store length of message sent
-    size_t len = strlen(s);
-    // Clamp the message to 16 bits
-    if (len > 0xFFFF)
-    {
-        len = 0xFFFF;
-    }
-    // Convert to network order
-    uint16_t nlen = htons((uint16_t)len);
-    // Send the length of the message first
-    if (write_all(fd, &nlen, sizeof nlen) < 0) 
-    {
-        return -1;
-    }
-    // Send the message second
-    if (write_all(fd, s, len) < 0)
-    {
-        return -1;
-    }
-    // Message sent successfully
-    return 0;
-}
-
-static int receive_frame(int fd, char* buf, size_t capacity)
-{
-    // Create a variable for incoming message length
-    uint16_t hlen;
-
-    // Attempt read of message length
-    if (read_all(fd, &hlen, sizeof hlen) < 0)
-    {
-        return -1;
-    }
-
-    // Revert length from network order
-    size_t len = ntohs(hlen);
-
-    // Check to make sure the incoming message is
-    // smaller than the buffer
-    if (len >= capacity)
-    {
-        // Read what can fit and make room for null terminator
-        size_t keep = capacity - 1;
-        if (read_all(fd, buf, keep) < 0)
-        {
-            return -1;
-        }
-
-        // Store the remainder in a temporary buffer
-        // to read and discard
-        size_t remainder = len - keep;
-        char dump[512];
-
-        while (remainder > 0)
-        {
-            // Attempt read of the remainder
-            size_t chunk = remainder > sizeof dump ? sizeof dump : remainder;
-            if (read_all(fd, dump, chunk) < 0) 
-            {
-                return -1;
-            }
-            remainder -= chunk;
-        }
-
-        buf[capacity - 1] = '\0';
-    }
-    // Othrwise read normally
-    else
-    {
-        if (read_all(fd, buf, len) < 0)
-        {
-            return -1;
-        }
-        buf[len] = '\0';
-    }
-    // Message received successfully
-    return 0;
-}
-
-
-//                  Queue Operations                    //
-
-static bool in_queue(const CarID* car, int fnum)
-{
-    // Loop through queue length to find floor
-    for (int i = 0; i < car->queue_len; ++i) 
-    {
-        if (car->q[i] == fnum) 
-        {
-            // if floor found return true
-            return true;
-        }
-    }
-
-    // Otherwise return false
-    return false;
-}
-
-static void queue_floor(CarID* car, int fnum)
+// Structure to hold a call waiting in the batch window
+typedef struct
 {
-    // Check to ensure there is space in the queue
-    if (car->queue_len < MAX_QUEUE)
-    {
-        // If there is space add floor to queue
-        car->q[car->queue_len++] = fnum;
-    }
-}
-
-static void dequeue_floor(CarID* car)
+    int socket_fd;
+    uint32_t trip_id;
+    dispatch_call_t call;
+} pending_call_t;
+
+// Batched call intake (a window of 0 assigns every call immediately)
+static unsigned g_batch_window_ms = 0;
+static pending_call_t g_batch[MAX_BATCH];
+static int g_batch_len = 0;
+static pthread_mutex_t g_batch_mtx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_batch_cv;
+
+// Destination dispatch groups calls from the same floor whose destinations
+// lie within this many floors of each other (-1 disables grouping)
+static int g_dd_span = -1;
+
+// Idle cars are parked after this long without work (0 disables parking)
+static unsigned g_park_idle_ms = 0;
+
+// Traffic counters are written here on SIGUSR1 (NULL disables dumps)
+static const char* g_traffic_dump_path = NULL;
+
+// Registry snapshots are kept here (NULL disables snapshots)
+static const char* g_snapshot_path = NULL;
+
+// Address and port cars and call pads connect on
+static const char* g_listen_host = "0.0.0.0";
+static int g_ctrl_port = CTRL_PORT;
+// Backlog, buffer and keepalive settings for every socket
+static net_config_t g_net = NET_CONFIG_DEFAULT;
+// Acceptor threads, each with its own SO_REUSEPORT listener pinned to a core
+static int g_acceptors = 1;
+// Workers handling new connections and the depth of their queue
+static int g_pool_workers = POOL_DEFAULT_WORKERS;
+static int g_pool_depth = POOL_DEFAULT_DEPTH;
+// Calls answered at once before new ones get BUSY (0 for no bound), and the
+// calls per second each source floor may make with their burst (0 for no limit)
+static int g_max_inflight = ADMIT_DEFAULT_INFLIGHT;
+// Longest a call may wait for a worker before it gets BUSY (0 for no bound)
+static int g_max_queue_ms = ADMIT_DEFAULT_QUEUE_MS;
+static unsigned g_call_rate = 0;
+static int g_call_burst = 5;
+// Least severe level logged and whether lines carry a timestamp
+static const char* g_log_level_name = "info";
+static int g_log_stamp = 0;
+
+// Primary: port a hot standby connects on to receive registry changes (0 disables)
+static int g_repl_port = 0;
+// Address the replication stream is served on, or the primary is followed at
+static const char* g_repl_host = LOCALHOST;
+// Standby: replication port of the primary being followed (0 when primary)
+static int g_follow_port = 0;
+// Car slots changed since they were last streamed to the standby
+static uint32_t g_repl_dirty = 0;
+static pthread_cond_t g_repl_cv = PTHREAD_COND_INITIALIZER;
+
+// Ports of peer zone controllers that take calls no local car can serve
+static int g_peer_ports[MAX_PEERS];
+static int g_n_peers = 0;
+// Address the peer zone controllers run on
+static const char* g_peer_host = LOCALHOST;
+// Longest a forwarded call waits on a peer to connect, send or reply
+static int g_peer_timeout_ms = 500;
+
+// Trip events are journalled here once the controller is serving (NULL disables)
+static const char* g_journal_path = NULL;
+
+// Replication stream operations
+enum
 {
-    // Check to ensure there is something to dequeue
-    if (car->queue_len <= 0) 
-    {
-        // if not return early
-        return;
-    }
-    // Shift all floors forward in the queue
-    for (int i = 1; i < car->queue_len; ++i) 
-    {
-        car->q[i-1] = car->q[i];
-    }
-    // Decrease queue length
-    car->queue_len--;
-}
+    REPL_UPSERT = 1,   // Car registered or its queue, trips or timings changed
+    REPL_REMOVE        // Car left the registry
+};
 
-static void enqueue(CarID* car, int src_floor, int dst_floor)
+// Structure to hold one replication record, streamed as raw bytes
+typedef struct
 {
-    // Check to ensure car is valid and is able to add to queue
-    if (!car || src_floor == dst_floor)
-    {
-        return;
-    }
-
-    // Check to make sure source floor is not already in queue
-    if (!in_queue(car, src_floor)) 
-    {
-        // Add source floor to queue
-        queue_floor(car, src_floor);
-    }
-
-    // Ensure destination floor is after source floor in queue
-    int src_index = -1, dst_index = -1;
-    for (int i = 0; i < car->queue_len; ++i)
-    {
-        // Find the indexes of source and destination floors
-        if (car->q[i] == src_floor && src_index < 0) 
-        {
-            // Store source index
-            src_index = i;
-        }
-        if (car->q[i] == dst_floor && dst_index < 0) 
-        {
-            // Store destination index
-            dst_index = i;
-        }
-    }
-    // Check if destination is before source
-    if (dst_index >= 0 && dst_index < src_index)
-    {
-        // If destination is before source remove destination from queue
-        for (int i = dst_index + 1; i < car->queue_len; ++i)
-        {
-            car->q[i-1] = car->q[i];
-        }
-        // Decrease queue length and reset destination index
-        car->queue_len--;
-        dst_index = -1;
-    }
-    // If destination is not in queue add to end of queue
-    if (dst_index < 0)
-    {
-        queue_floor(car, dst_floor);
-    }
-}
+    uint32_t op;
+    uint32_t reserved;
+    snapshot_car_t car;
+} repl_record_t;
 
+// Cars restored from a snapshot or the primary that have not re-registered yet
+static snapshot_car_t g_recovered[MAX_CARS];
+static int g_recovered_len = 0;
+static long g_recovered_until_ms = 0;
 
 //                  SHM Helper Functions                 //
 
@@ -333,14 +198,14 @@ static void shm_attach_car(CarID* car)
     car->shm_ptr = (car_shared_mem*)p;
 
     // Initialise car properties in shared memory
-    pthread_mutex_lock(&car->shm_ptr->mutex);
+    shm_lock(car->shm_ptr);
     // Initialise car to closed
     strncpy(car->shm_ptr->status, "Closed", sizeof car->shm_ptr->status - 1);
     // Initialise current and destination floors
     strncpy(car->shm_ptr->current_floor, car->cur_floor, sizeof car->shm_ptr->current_floor - 1);
     strncpy(car->shm_ptr->destination_floor, car->dst_floor, sizeof car->shm_ptr->destination_floor - 1);
     // Notify any waiting processes of changes
-    pthread_cond_broadcast(&car->shm_ptr->cond);
+    shm_notify(car->shm_ptr, SHM_ALL);
     // Unlock the mutex
     pthread_mutex_unlock(&car->shm_ptr->mutex);
 }
@@ -378,78 +243,36 @@ static void fetch_shm_status(CarID* car, const char* status, const char* cur, co
         return;
     }
     // Lock the mutex and copy status information
-    pthread_mutex_lock(&car->shm_ptr->mutex);
+    shm_lock(car->shm_ptr);
     strncpy(car->shm_ptr->status, status, sizeof car->shm_ptr->status - 1);
     strncpy(car->shm_ptr->current_floor, cur, sizeof car->shm_ptr->current_floor - 1);
     strncpy(car->shm_ptr->destination_floor, dst, sizeof car->shm_ptr->destination_floor - 1);
     // Notify any waiting processes of changes
-    pthread_cond_broadcast(&car->shm_ptr->cond);
+    shm_notify(car->shm_ptr, SHM_DOORS | SHM_MOTION);
     // Unlock the mutex
     pthread_mutex_unlock(&car->shm_ptr->mutex);
 }
 
 
-//                  Handlers                  //
+//                  Trip Tracking                 //
 
-static int floor_num_handler(const char *f, int *out)
+static void journal_trip(trip_event_t event, const CarID* car, const trip_t* trip, long eta_ms)
 {
-    // Check to ensure that f is valid
-    if (!f || !*f)
-    {
-        return 0;
-    }
-
-    // Handle negative conversions for basement floors (b or B)
-    if (f[0] == 'b' || f[0] == 'B')
-    {
-        // Convert the string to long integer ingoring leading B/b
-        char *end = NULL;
-        long i = strtol(f + 1, &end, 10);
-        // Check to make sure floor has been parsed
-        // and is within 1 to 99
-        if (end == f + 1 || i < 1 || i > 99)
-        {
-            return 0;
-        }
-        // Valid floor is passed to pointer and returns successfully
-        *out = -(int)i;
-        return 1;
-    }
-    // Otherwise handle positive floor numbers
-    else
-    {
-        // Convert the string to long integer
-        char *end = NULL;
-        long i = strtol(f, &end, 10);
-        // Check to make sure floor has been parsed
-        // and is within 1 to 999
-        if (end == f || i < 1 || i > 999)
-        {
-            return 0;
-        }
-        // Valid floor is passed to pointer and returns successfully
-        *out = (int)i;
-        return 1;
-    }
+    // Journal each trip event against the car serving it
+    static const uint8_t type[] = {JOURNAL_ASSIGN, JOURNAL_PICKUP, JOURNAL_DROPOFF};
+    journal_append(type[event], trip->id, trip->src_floor, trip->dst_floor, car->name, (uint32_t)eta_ms);
 }
 
-static void index_handler(int index, char out[4])
+static void repl_mark(const CarID* car)
 {
-    // Checks if a floor is negative based on the index
-    if (index < 0)
-    {
-        // If it is negative then the string should
-        // be formatted with a leading B
-        snprintf(out, 4, "B%d", -index);
-    }
-    else 
+    // Queue the car's slot for the replication thread (registry lock held)
+    if (g_repl_port > 0)
     {
-        // Otherwise format as a standard number
-        snprintf(out, 4, "%d", index);
+        g_repl_dirty |= 1u << (car - g_cars);
+        pthread_cond_signal(&g_repl_cv);
     }
 }
 
-
 static void update_status(int socket_fd, const char* status, const char* cur, const char* dst)
 {
     REGISTRY_LOCK();
@@ -459,11 +282,8 @@ static void update_status(int socket_fd, const char* status, const char* cur, co
         // if car found update its status
         if (g_cars[i].in_use && g_cars[i].socket_fd == socket_fd)
         {
-            // Update car status 
-            strncpy(g_cars[i].status, status, sizeof g_cars[i].status - 1);
-            // Update current and destination floors
-            strncpy(g_cars[i].cur_floor, cur, sizeof g_cars[i].cur_floor - 1);
-            strncpy(g_cars[i].dst_floor, dst, sizeof g_cars[i].dst_floor - 1);
+            // Update car status and re-estimate its route
+            car_observe(&g_cars[i], status, cur, dst, now_ms());
             // Update shared memory status
             fetch_shm_status(&g_cars[i], status, cur, dst);
             break;
@@ -491,28 +311,6 @@ static CarID* find_registry(const char* name)
 
 //                  Car Managers                  //
 
-static bool can_service(const CarID* car, int src_floor, int dst_floor)
-{
-    // Check to make sure car is valid and in use
-    if (!car || !car->in_use) 
-    {
-        return false;
-    }
-    // Check to make sure source floor is within the cars service range
-    if (src_floor < car->lowest_floor || src_floor > car->highest_floor) 
-    {
-        return false;
-    }
-    // Check to make sure destination floor is within the cars service range
-    if (dst_floor < car->lowest_floor || dst_floor > car->highest_floor) 
-    {
-        return false;
-    }
-
-    // Car can service the requested trip
-    return true;
-}
-
 static void remove_car(int socket_fd)
 {
     REGISTRY_LOCK();
@@ -527,6 +325,8 @@ static void remove_car(int socket_fd)
             g_cars[i].socket_fd = -1;
             g_cars[i].name[0] = '\0';
             g_cars[i].queue_len = 0;
+            g_cars[i].trip_count = 0;
+            repl_mark(&g_cars[i]);
             break;
         }
     }
@@ -550,33 +350,85 @@ static void send_car(CarID* car)
     (void)send_frame(car->socket_fd, tx_buf);
 }
 
-
 static bool car_selector(int src_floor, int dst_floor, char out_name[32])
 {
-    bool found = false;
+    int slot = traffic_slot(time(NULL));
     REGISTRY_LOCK();
-    // Loop through cars to find one that can service the trip
-    for (int i = 0; i < MAX_CARS; ++i)
+    // Find the car that reaches the caller soonest
+    int i = select_car(g_cars, MAX_CARS, src_floor, dst_floor, g_dd_span, now_ms(), slot);
+    bool found = i >= 0;
+    if (found)
+    {
+        // Copy car name to output
+        strncpy(out_name, g_cars[i].name, 31);
+        out_name[31] = '\0';
+    }
+    REGISTRY_UNLOCK();
+    // Return result
+    return found;
+}
+
+//                  Crash Recovery                  //
+
+static void recover_car(CarID* car)
+{
+    for (int r = 0; r < g_recovered_len; ++r)
     {
-        // If a car is in use
-        if (!g_cars[i].in_use)
+        const snapshot_car_t* s = &g_recovered[r];
+        // Only restore a car that still serves the floors it did
+        if (strcmp(s->name, car->name) != 0 || s->lowest_floor != car->lowest_floor ||
+            s->highest_floor != car->highest_floor)
         {
-            // skip to next car
             continue;
         }
-        // If car can service source and desitnation floors
-        if (can_service(&g_cars[i], src_floor, dst_floor))
+        // Restore the stops, trips and learned timings
+        for (int k = 0; k < s->queue_len; ++k)
         {
-            // Copy car name to output and mark as found
-            strncpy(out_name, g_cars[i].name, 31);
-            out_name[31] = '\0';
-            found = true;
-            break;
+            car->q[k] = s->q[k];
         }
+        car->queue_len = s->queue_len;
+        memcpy(car->trips, s->trips, (size_t)s->trip_count * sizeof *car->trips);
+        car->trip_count = s->trip_count;
+        car->timing = s->timing;
+        route_refresh(car, now_ms());
+        // The car has claimed its state
+        g_recovered[r] = g_recovered[--g_recovered_len];
+        return;
     }
-    REGISTRY_UNLOCK();
-    // Return result
-    return found;
+}
+
+static void recovery_expire(long now)
+{
+    // Wait out the grace period for cars to re-register
+    if (g_recovered_len == 0 || now < g_recovered_until_ms)
+    {
+        return;
+    }
+    // Hand passengers still waiting for an absent car to another car
+    for (int r = 0; r < g_recovered_len; ++r)
+    {
+        const snapshot_car_t* s = &g_recovered[r];
+        for (int k = 0; k < s->trip_count; ++k)
+        {
+            const trip_t* t = &s->trips[k];
+            if (t->picked_up)
+            {
+                continue;
+            }
+            int i = select_car(g_cars, MAX_CARS, t->src_floor, t->dst_floor, g_dd_span, now, traffic_slot(time(NULL)));
+            if (i < 0)
+            {
+                journal_append(JOURNAL_REJECT, t->id, t->src_floor, t->dst_floor, NULL, 0);
+                continue;
+            }
+            enqueue(&g_cars[i], t->src_floor, t->dst_floor);
+            route_refresh(&g_cars[i], now);
+            send_car(&g_cars[i]);
+            trip_assign(&g_cars[i], t->id, t->src_floor, t->dst_floor, car_eta_ms(&g_cars[i], t->src_floor, now));
+            repl_mark(&g_cars[i]);
+        }
+    }
+    g_recovered_len = 0;
 }
 
 static int car_connection_manager(int socket_fd, const char* name, const char* lowest, const char* highest)
@@ -644,9 +496,15 @@ static int car_connection_manager(int socket_fd, const char* name, const char* l
     strncpy(g_cars[index].dst_floor, lowest, sizeof g_cars[index].dst_floor - 1);
     g_cars[index].queue_len = 0;
 
+    // Start the kinematic model from default timings
+    car_model_reset(&g_cars[index], now_ms());
+    // Take over the queue the car had before a controller restart
+    recover_car(&g_cars[index]);
+
     // Initialise shared memory details
     g_cars[index].shm_fd  = -1;
     g_cars[index].shm_ptr = NULL;
+    repl_mark(&g_cars[index]);
 
     REGISTRY_UNLOCK();
 
@@ -664,33 +522,459 @@ static void car_scheduler_handler(CarID* car)
         return;
     }
 
-    // Make sure the queue length is greater than 0
-    if (car->queue_len > 0) 
+    // Service the head of the queue and send the car on if work remains
+    if (car_schedule(car, now_ms()))
+    {
+        send_car(car);
+    }
+    repl_mark(car);
+}
+
+//                  Batch Dispatch                  //
+
+static void batch_dispatch(const pending_call_t* calls, int n)
+{
+    char names[MAX_BATCH][32];
+    long eta[MAX_BATCH];
+    dispatch_call_t req[MAX_BATCH];
+    int car_of[MAX_BATCH];
+    bool sent[MAX_CARS] = {false};
+
+    // Take the floors of each call for the solver
+    for (int c = 0; c < n; ++c)
+    {
+        req[c] = calls[c].call;
+    }
+
+    REGISTRY_LOCK();
+    // Jointly assign and enqueue the batch
+    long now = now_ms();
+    batch_assign(g_cars, MAX_CARS, req, n, g_dd_span, now, traffic_slot(time(NULL)), car_of);
+    for (int c = 0; c < n; ++c)
     {
-        // Capture the head of the queue
-        char head_str[16];
-        index_handler(car->q[0], head_str);
-        // If the car is the desitnation floor and has a status of Opening dequeue it
-        if (strcmp(car->status, "Opening") == 0 && strcmp(car->cur_floor, head_str) == 0)
+        names[c][0] = '\0';
+        eta[c] = 0;
+        if (car_of[c] < 0)
+        {
+            journal_append(JOURNAL_REJECT, calls[c].trip_id, req[c].src_floor, req[c].dst_floor, NULL, 0);
+            continue;
+        }
+        CarID* car = &g_cars[car_of[c]];
+        // Send each car that received work to the head of its queue
+        if (!sent[car_of[c]])
         {
-            // Floor has been serviced
-            dequeue_floor(car);
+            send_car(car);
+            sent[car_of[c]] = true;
         }
+        // Estimate arrival for the caller on the updated route
+        eta[c] = car_eta_ms(car, req[c].src_floor, now);
+        trip_assign(car, calls[c].trip_id, req[c].src_floor, req[c].dst_floor, eta[c]);
+        repl_mark(car);
+        strncpy(names[c], car->name, sizeof names[c] - 1);
+        names[c][sizeof names[c] - 1] = '\0';
     }
-    // If there are still floors in the queue
-    if (car->queue_len > 0)
+    REGISTRY_UNLOCK();
+
+    // Reply to every caller in the batch
+    for (int c = 0; c < n; ++c)
     {
-        // Send car to the next floor in the queue
-        send_car(car);
+        if (names[c][0] != '\0')
+        {
+            char tx_buf[64];
+            snprintf(tx_buf, sizeof tx_buf, "CAR %s %ld", names[c], eta[c]);
+            (void)send_frame(calls[c].socket_fd, tx_buf);
+        }
+        else
+        {
+            (void)send_frame(calls[c].socket_fd, "UNAVAILABLE");
+        }
+        // Shut down and close the socket
+        shutdown(calls[c].socket_fd, SHUT_WR);
+        close(calls[c].socket_fd);
+        admit_done();
+    }
+}
+
+static bool batch_submit(int socket_fd, int src_floor, int dst_floor, uint32_t trip_id)
+{
+    bool queued = false;
+    pthread_mutex_lock(&g_batch_mtx);
+    // Add the call to the open batch if there is room
+    if (g_batch_len < MAX_BATCH)
+    {
+        g_batch[g_batch_len].socket_fd = socket_fd;
+        g_batch[g_batch_len].call.src_floor = src_floor;
+        g_batch[g_batch_len].call.dst_floor = dst_floor;
+        g_batch[g_batch_len].trip_id = trip_id;
+        g_batch_len++;
+        queued = true;
+        // Wake the batch thread to open a window or flush a full batch
+        if (g_batch_len == 1 || g_batch_len == MAX_BATCH)
+        {
+            pthread_cond_signal(&g_batch_cv);
+        }
+    }
+    pthread_mutex_unlock(&g_batch_mtx);
+    // Return whether the batch thread now owns the socket
+    return queued;
+}
+
+static void *batch_thread(void *arg)
+{
+    (void)arg;
+    pending_call_t calls[MAX_BATCH];
+
+    for (;;)
+    {
+        pthread_mutex_lock(&g_batch_mtx);
+        // Sleep until the first call of a batch arrives
+        while (g_batch_len == 0)
+        {
+            pthread_cond_wait(&g_batch_cv, &g_batch_mtx);
+        }
+        // Gather calls until the window closes or the batch is full
+        struct timespec window = abs_timeout_ms(g_batch_window_ms);
+        while (g_batch_len < MAX_BATCH)
+        {
+            if (pthread_cond_timedwait(&g_batch_cv, &g_batch_mtx, &window) == ETIMEDOUT)
+            {
+                break;
+            }
+        }
+        // Take the batch and reopen intake before solving
+        int n = g_batch_len;
+        memcpy(calls, g_batch, (size_t)n * sizeof *calls);
+        g_batch_len = 0;
+        pthread_mutex_unlock(&g_batch_mtx);
+
+        batch_dispatch(calls, n);
+    }
+    return NULL;
+}
+
+//                  Parking                 //
+
+static int park_choose(const CarID* car, const int taken[], int n_taken, int slot, long now)
+{
+    // Forecast demand over the car's floors, only used by the parking thread
+    static double weight[TRAFFIC_FLOORS];
+    traffic_origins(slot, car->lowest_floor, car->highest_floor, weight, now);
+
+    int best = 0;
+    double best_weight = 0.0;
+    // Pick the busiest call origin this slot the car can reach
+    for (int f = car->lowest_floor; f <= car->highest_floor; ++f)
+    {
+        double w = weight[f - car->lowest_floor];
+        // Skip floors another idle car is already covering
+        for (int k = 0; k < n_taken && w > best_weight; ++k)
+        {
+            if (taken[k] == f)
+            {
+                w = 0.0;
+            }
+        }
+        if (w > best_weight)
+        {
+            best_weight = w;
+            best = f;
+        }
+    }
+    // Return the home floor (0 when there is no demand to follow)
+    return best;
+}
+
+static void park_idle_cars(void)
+{
+    int taken[MAX_CARS];
+    int n_taken = 0;
+    // Find the time of day slot to take demand from
+    int slot = traffic_slot(time(NULL));
+
+    REGISTRY_LOCK();
+    long now = now_ms();
+    for (int i = 0; i < MAX_CARS; ++i)
+    {
+        CarID* car = &g_cars[i];
+        if (!car->in_use)
+        {
+            continue;
+        }
+        // A car with work is not parked (enqueue cleared its parking floor)
+        if (car->queue_len > 0)
+        {
+            continue;
+        }
+        // Only park cars that have been closed for the idle time
+        if (strcmp(car->status, "Closed") != 0 || now - car->state_since_ms < (long)g_park_idle_ms)
+        {
+            continue;
+        }
+        // Choose a home floor away from the other parked cars
+        int home = park_choose(car, taken, n_taken, slot, now);
+        if (home == 0)
+        {
+            continue;
+        }
+        taken[n_taken++] = home;
+        // Send the car home unless it is already there or on its way
+        int cur;
+        if (home != car->park_floor && floor_num_handler(car->cur_floor, &cur) && cur != home)
+        {
+            char home_str[4], tx_buf[32];
+            index_handler(home, home_str);
+            snprintf(tx_buf, sizeof tx_buf, "FLOOR %s", home_str);
+            (void)send_frame(car->socket_fd, tx_buf);
+        }
+        car->park_floor = home;
+    }
+    REGISTRY_UNLOCK();
+}
+
+static void *traffic_dump_thread(void *arg)
+{
+    // SIGUSR1 is blocked in every thread and accepted here
+    sigset_t* set = (sigset_t*)arg;
+    for (;;)
+    {
+        int sig;
+        if (sigwait(set, &sig) != 0)
+        {
+            continue;
+        }
+        // Write the counters to a temporary file and move it into place
+        char tmp_path[512];
+        snprintf(tmp_path, sizeof tmp_path, "%s.tmp", g_traffic_dump_path);
+        FILE* out = fopen(tmp_path, "w");
+        if (!out)
+        {
+            LOG_ERROR("Traffic dump error: %s", strerror(errno));
+            continue;
+        }
+        int err = traffic_dump(out, now_ms());
+        if (fclose(out) != 0 || err != 0 || rename(tmp_path, g_traffic_dump_path) != 0)
+        {
+            LOG_ERROR("Traffic dump error: %s", strerror(errno));
+        }
+    }
+    return NULL;
+}
+
+static void *park_thread(void *arg)
+{
+    (void)arg;
+    // Check for idle cars a few times per idle period
+    unsigned period = g_park_idle_ms / 4 > 0 ? g_park_idle_ms / 4 : 1;
+    for (;;)
+    {
+        struct timespec ts;
+        ts.tv_sec = period / 1000u;
+        ts.tv_nsec = (long)(period % 1000u) * 1000000L;
+        while (nanosleep(&ts, &ts) == -1 && errno == EINTR)
+        {}
+        park_idle_cars();
+    }
+    return NULL;
+}
+
+//                  Snapshots                 //
+
+static void *snapshot_thread(void *arg)
+{
+    (void)arg;
+    for (;;)
+    {
+        struct timespec ts;
+        ts.tv_sec = SNAPSHOT_PERIOD_MS / 1000u;
+        ts.tv_nsec = (long)(SNAPSHOT_PERIOD_MS % 1000u) * 1000000L;
+        while (nanosleep(&ts, &ts) == -1 && errno == EINTR)
+        {}
+        REGISTRY_LOCK();
+        // Persist the registry and queues, keeping unclaimed recovered cars
+        snapshot_save(g_cars, MAX_CARS, g_recovered, g_recovered_len);
+        // Re-dispatch trips of cars that did not come back in time
+        recovery_expire(now_ms());
+        REGISTRY_UNLOCK();
+    }
+    return NULL;
+}
+
+//                  Replication                 //
+
+static void *repl_thread(void *arg)
+{
+    // Listening socket for the standby, bound by main
+    int ls = *(int*)arg;
+    // Name last streamed from each slot so departures can be sent
+    static char sent[MAX_CARS][32];
+    static repl_record_t out[2 * MAX_CARS];
+
+    for (;;)
+    {
+        int fd = accept(ls, NULL, NULL);
+        if (fd == -1)
+        {
+            continue;
+        }
+        REGISTRY_LOCK();
+        // A new standby starts from the full registry
+        memset(sent, 0, sizeof sent);
+        g_repl_dirty = (1u << MAX_CARS) - 1u;
+        REGISTRY_UNLOCK();
+
+        for (;;)
+        {
+            int n = 0;
+            REGISTRY_LOCK();
+            // Sleep until a car changes
+            while (g_repl_dirty == 0)
+            {
+                pthread_cond_wait(&g_repl_cv, &g_cars_mtx);
+            }
+            // Copy the changed cars so the socket is written without the lock
+            for (int i = 0; i < MAX_CARS; ++i)
+            {
+                if (!(g_repl_dirty & (1u << i)))
+                {
+                    continue;
+                }
+                // The car last sent from this slot has left
+                if (sent[i][0] != '\0' && (!g_cars[i].in_use || strcmp(sent[i], g_cars[i].name) != 0))
+                {
+                    memset(&out[n], 0, sizeof out[n]);
+                    out[n].op = REPL_REMOVE;
+                    memcpy(out[n].car.name, sent[i], sizeof out[n].car.name);
+                    sent[i][0] = '\0';
+                    n++;
+                }
+                if (g_cars[i].in_use)
+                {
+                    out[n].op = REPL_UPSERT;
+                    out[n].reserved = 0;
+                    snapshot_car(&g_cars[i], &out[n].car);
+                    memcpy(sent[i], g_cars[i].name, sizeof sent[i]);
+                    n++;
+                }
+            }
+            g_repl_dirty = 0;
+            REGISTRY_UNLOCK();
+
+            // Stream the records, waiting for a new standby if this one is gone
+            if (write_all(fd, out, (size_t)n * sizeof *out) < 0)
+            {
+                break;
+            }
+        }
+        close(fd);
     }
+    return NULL;
+}
+
+static void standby_follow(void)
+{
+    // Connect to the primary's replication port, waiting for it to come up
+    int fd;
+    for (;;)
+    {
+        fd = net_connect(&g_net, g_repl_host, g_follow_port, 0);
+        if (fd != -1)
+        {
+            break;
+        }
+        struct timespec ts = {0, 100000000L};
+        nanosleep(&ts, NULL);
+    }
+    LOG_INFO("Standby following primary on port %d", g_follow_port);
+
+    // Mirror the primary's registry until the stream ends
+    repl_record_t rec;
+    while (read_all(fd, &rec, sizeof rec) == (ssize_t)sizeof rec)
+    {
+        rec.car.name[sizeof rec.car.name - 1] = '\0';
+        // Ignore records that would overrun the car's arrays
+        if (rec.car.queue_len < 0 || rec.car.queue_len > MAX_QUEUE ||
+            rec.car.trip_count < 0 || rec.car.trip_count > MAX_QUEUE)
+        {
+            continue;
+        }
+        int slot = -1;
+        for (int r = 0; r < g_recovered_len; ++r)
+        {
+            if (strcmp(g_recovered[r].name, rec.car.name) == 0)
+            {
+                slot = r;
+                break;
+            }
+        }
+        if (rec.op == REPL_UPSERT)
+        {
+            if (slot < 0 && g_recovered_len < MAX_CARS)
+            {
+                slot = g_recovered_len++;
+            }
+            if (slot >= 0)
+            {
+                g_recovered[slot] = rec.car;
+            }
+        }
+        else if (rec.op == REPL_REMOVE && slot >= 0)
+        {
+            g_recovered[slot] = g_recovered[--g_recovered_len];
+        }
+    }
+    close(fd);
+
+    // The primary is gone, so take over its cars as they reconnect
+    LOG_WARN("Primary lost, taking over %d cars", g_recovered_len);
+    g_recovered_until_ms = now_ms() + RECOVERY_GRACE_MS;
+}
+
+//                  Zones                 //
+
+static bool local_can_serve(int src_floor, int dst_floor)
+{
+    REGISTRY_LOCK();
+    // Check whether any car in this zone covers the trip
+    bool served = select_car(g_cars, MAX_CARS, src_floor, dst_floor, -1, now_ms(), 0) >= 0;
+    REGISTRY_UNLOCK();
+    return served;
+}
+
+static bool forward_call(const char* src_floor, const char* dst_floor, char reply[64])
+{
+    // Mark the call as forwarded so the peer serves it or refuses it
+    char tx_buf[32];
+    snprintf(tx_buf, sizeof tx_buf, "CALL %s %s FWD", src_floor, dst_floor);
+    // Offer the call to each peer in turn until one assigns a car
+    for (int p = 0; p < g_n_peers; ++p)
+    {
+        // A worker waits on the peer at most the timeout per step, so a hung
+        // peer or two zones forwarding to each other cannot pin the pool
+        int fd = net_connect(&g_net, g_peer_host, g_peer_ports[p], g_peer_timeout_ms);
+        if (fd == -1)
+        {
+            continue;
+        }
+        bool assigned = send_frame(fd, tx_buf) == 0 &&
+                        receive_frame(fd, reply, 64) == 0 &&
+                        strncmp(reply, "CAR ", 4) == 0;
+        close(fd);
+        if (assigned)
+        {
+            return true;
+        }
+    }
+    // No peer could take the call
+    return false;
 }
 
 //                  TCP and Thread Handlers                 //
 
-// Structure to hold TCP thread arguments
+// Structure to hold car thread arguments
 typedef struct 
 {
     int socket_fd; 
+    char name[32];
 } tcp_args_t;
 
 
@@ -746,11 +1030,11 @@ static void tcp_car_thread(int socket_fd, const char* name)
     }
 }
 
-static void tcp_call_thread(int socket_fd, const char* frame)
+static void tcp_call_thread(int socket_fd, const char* frame, long queued_ms)
 {
     // Extract source and destination floors from the CALL frame
-    char src_floor[4]={0}, dst_floor[4]={0};
-    (void)sscanf(frame, "CALL %3s %3s", src_floor, dst_floor);
+    char src_floor[4]={0}, dst_floor[4]={0}, tag[4]={0};
+    (void)sscanf(frame, "CALL %3s %3s %3s", src_floor, dst_floor, tag);
     int src_floor_int, dst_floor_int;
     // Check the make sure the floor inputs are valid
     if (!floor_num_handler(src_floor, &src_floor_int)|| !floor_num_handler(dst_floor, &dst_floor_int)|| src_floor_int == dst_floor_int)
@@ -763,16 +1047,62 @@ static void tcp_call_thread(int socket_fd, const char* frame)
         return;
     }
 
+    // Shed the call at once when it waited too long for a worker, or the
+    // controller or its source floor is over its limit, so admitted calls
+    // keep their latency under overload. Shed calls are retried, so they
+    // are neither counted nor journaled.
+    if (admit_call(src_floor_int, now_ms(), queued_ms) != ADMIT_OK)
+    {
+        LOG_DEBUG("Call %s to %s shed, controller busy", src_floor, dst_floor);
+        (void)send_frame(socket_fd, "BUSY");
+        shutdown(socket_fd, SHUT_WR);
+        close(socket_fd);
+        return;
+    }
+
+    // Count the call for demand forecasting
+    traffic_record(src_floor_int, dst_floor_int, time(NULL), now_ms());
+
+    // Journal the call under a new trip id
+    uint32_t trip_id = journal_trip_id();
+    journal_append(JOURNAL_CALL, trip_id, src_floor_int, dst_floor_int, NULL, 0);
+
+    // Hand calls no car in this zone can serve to a peer zone. Forwarded
+    // calls are never forwarded again so they cannot loop between zones.
+    if (g_n_peers > 0 && strcmp(tag, "FWD") != 0 && !local_can_serve(src_floor_int, dst_floor_int))
+    {
+        char reply[64];
+        if (forward_call(src_floor, dst_floor, reply))
+        {
+            // Relay the peer's assignment to the caller
+            char peer_car[32] = {0};
+            long eta = 0;
+            (void)sscanf(reply, "CAR %31s %ld", peer_car, &eta);
+            journal_append(JOURNAL_FORWARD, trip_id, src_floor_int, dst_floor_int, peer_car, (uint32_t)eta);
+            (void)send_frame(socket_fd, reply);
+        }
+        else
+        {
+            journal_append(JOURNAL_REJECT, trip_id, src_floor_int, dst_floor_int, NULL, 0);
+            (void)send_frame(socket_fd, "UNAVAILABLE");
+        }
+        shutdown(socket_fd, SHUT_WR);
+        close(socket_fd);
+        admit_done();
+        return;
+    }
+
+    // When batching is enabled the batch thread replies and closes the socket
+    if (g_batch_window_ms > 0 && batch_submit(socket_fd, src_floor_int, dst_floor_int, trip_id))
+    {
+        return;
+    }
+
     char car_name[32];
     // Check to see if a car can service the trip
     if (car_selector(src_floor_int, dst_floor_int, car_name))
     {
-        
-        char tx_buf[64];
-        // If a car is found send the CAR frame
-        snprintf(tx_buf, sizeof tx_buf, "CAR %s", car_name);
-        (void)send_frame(socket_fd, tx_buf);
-
+        long eta = 0;
         REGISTRY_LOCK();
         // Find the car in the registry
         CarID* car = find_registry(car_name);
@@ -781,152 +1111,389 @@ static void tcp_call_thread(int socket_fd, const char* frame)
         {
             // If it is valid send the car to service the request
             enqueue(car, src_floor_int, dst_floor_int);
+            long now = now_ms();
+            route_refresh(car, now);
             send_car(car);
+            // Estimate when the car reaches the caller
+            eta = car_eta_ms(car, src_floor_int, now);
+            trip_assign(car, trip_id, src_floor_int, dst_floor_int, eta);
+            repl_mark(car);
         }
         REGISTRY_UNLOCK();
+
+        char tx_buf[64];
+        // Send the CAR frame with the estimated arrival in ms
+        snprintf(tx_buf, sizeof tx_buf, "CAR %s %ld", car_name, eta);
+        LOG_DEBUG("Call %s to %s assigned to car %s, eta %ld ms", src_floor, dst_floor, car_name, eta);
+        (void)send_frame(socket_fd, tx_buf);
     } 
     // Otherwise no car available to service the trip
     else
     {
         // Notify caller that no car is available
+        journal_append(JOURNAL_REJECT, trip_id, src_floor_int, dst_floor_int, NULL, 0);
         (void)send_frame(socket_fd, "UNAVAILABLE");
     }
     // Shut down and close the socket
     shutdown(socket_fd, SHUT_WR);
     close(socket_fd);
+    admit_done();
 }
 
-static void *tcp_thread(void *arg)
+static void *tcp_car_main(void *arg)
 {
-    // Extract socket file descriptor from arguments
+    // Extract socket file descriptor and car name from arguments
     tcp_args_t *args = (tcp_args_t*) arg;
     int socket_fd = args->socket_fd;
+    char name[32];
+    memcpy(name, args->name, sizeof name);
     // Deallocate argument structure
     free(args);
 
+    // Serve the car until it disconnects
+    tcp_car_thread(socket_fd, name);
+    return NULL;
+}
+
+static void tcp_stats(int socket_fd)
+{
+    pool_stats_t st;
+    pool_stats(&st);
+    admit_stats_t ad;
+    admit_stats(&ad);
+    char tx_buf[512];
+    // Report the worker pool, its queue and call admission
+    snprintf(tx_buf, sizeof tx_buf, "STATS workers=%d busy=%d queued=%d capacity=%d peak=%d wait_peak_ms=%ld "
+             "handled=%llu stalls=%llu inflight=%d inflight_peak=%d admitted=%llu shed_busy=%llu "
+             "shed_queue=%llu shed_rate=%llu",
+             st.workers, st.busy, st.queued, st.capacity, st.peak, st.wait_peak_ms,
+             (unsigned long long)st.handled, (unsigned long long)st.stalls,
+             ad.inflight, ad.peak, (unsigned long long)ad.admitted,
+             (unsigned long long)ad.shed_busy, (unsigned long long)ad.shed_queue,
+             (unsigned long long)ad.shed_rate);
+    (void)send_frame(socket_fd, tx_buf);
+    shutdown(socket_fd, SHUT_WR);
+    close(socket_fd);
+}
+
+static void tcp_connection(int socket_fd, long queued_ms)
+{
+    // Bound the wait for the first frame so a silent client cannot hold a worker
+    struct timeval timeout = {FIRST_FRAME_TIMEOUT_MS / 1000, (FIRST_FRAME_TIMEOUT_MS % 1000) * 1000};
+    setsockopt(socket_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof timeout);
+
     char first_frame[256];
     // Attempt to receive the first frame
     if (receive_frame(socket_fd, first_frame, sizeof first_frame) < 0)
     {
-        // On error close the socket and exit thread
+        // On error close the socket
         close(socket_fd);
-        return NULL;
+        return;
     }
 
     // Check if the frame contains a CAR registration
     if (strncmp(first_frame, "CAR ", 4) == 0)
     {
+        // Car connections stay open, so they block without a timeout
+        struct timeval forever = {0, 0};
+        setsockopt(socket_fd, SOL_SOCKET, SO_RCVTIMEO, &forever, sizeof forever);
+
+        // Allocate memory to pass arguement to thread
+        tcp_args_t* args = (tcp_args_t*)malloc(sizeof *args);
+        if (!args)
+        {
+            close(socket_fd);
+            return;
+        }
+        args->socket_fd = socket_fd;
         // Extract car name and floor range from the CAR frame
-        char name[32] = {0}, car_lowest_floor[4] = {0}, car_highest_floor[4] = {0};
-        (void)sscanf(first_frame, "CAR %31s %3s %3s", name, car_lowest_floor, car_highest_floor);
+        char car_lowest_floor[4] = {0}, car_highest_floor[4] = {0};
+        memset(args->name, 0, sizeof args->name);
+        (void)sscanf(first_frame, "CAR %31s %3s %3s", args->name, car_lowest_floor, car_highest_floor);
         // Manage the car connection and registration
-        int index = car_connection_manager(socket_fd, name, car_lowest_floor, car_highest_floor);
-        if (index < 0)
+        if (car_connection_manager(socket_fd, args->name, car_lowest_floor, car_highest_floor) < 0)
+        {
+            // on error close the socket
+            close(socket_fd);
+            free(args);
+            return;
+        }
+        // Give the car its own thread so it does not hold a worker
+        pthread_t th;
+        if (pthread_create(&th, NULL, tcp_car_main, args) != 0)
         {
-            // on error close the socket and exit thread
+            LOG_ERROR("Pthread_create Error: %s", strerror(errno));
+            remove_car(socket_fd);
             close(socket_fd);
-            return NULL;
+            free(args);
+            return;
         }
-        // Start the car TCP handler thread
-        tcp_car_thread(socket_fd, name);
+        // Detach the thread
+        pthread_detach(th);
     }
     // Otherwise check if the frame contains a CALL request
     else if (strncmp(first_frame, "CALL ", 5) == 0)
     {
-        // Invoke call thread
-        tcp_call_thread(socket_fd, first_frame);
+        // Handle the call on this worker
+        tcp_call_thread(socket_fd, first_frame, queued_ms);
+    }
+    // Report pool metrics
+    else if (strcmp(first_frame, "STATS") == 0)
+    {
+        tcp_stats(socket_fd);
     }
     else
     // otherwise close the socket
     {
         close(socket_fd);
     }
+}
+
+// Structure to hold an acceptor thread's listener and core
+typedef struct
+{
+    int listen_fd;
+    int cpu;
+} acceptor_t;
+
+static void *acceptor_thread(void *arg)
+{
+    acceptor_t* acc = (acceptor_t*)arg;
+    // Keep this listener's accepts and handshakes on one core
+    if (acc->cpu >= 0)
+    {
+        (void)thread_pin_cpu(acc->cpu);
+    }
+
+    // Connection loop
+    for (;;)
+    {
+        // Initialise the client client connection
+        struct sockaddr_in client_addr;
+        socklen_t client_len = sizeof(client_addr);
+        // Wait for request and attempt accept
+        int client_socket = accept(acc->listen_fd, (struct sockaddr*)&client_addr, &client_len);
+        if (client_socket == -1)
+        {
+            LOG_ERROR("Accepting Error: %s", strerror(errno));
+            break;
+        }
 
+        // Queue the connection for a pool worker
+        pool_submit(client_socket);
+    }
     return NULL;
 }
 
-
 // ---------------- main ----------------
 
 int main(int argc, char *argv[])
 {
-    (void)argc; 
-    (void)argv;
-
-    // Initialise the socket to IPv4
-    int s = socket(AF_INET, SOCK_STREAM, 0);
-    if (s == -1)
+    // Options, settable on the command line or in a --config file
+    config_option_t opts[] = {
+        {"batch-ms", 'b', CONFIG_UNSIGNED, &g_batch_window_ms, NULL, 0, 0, 0, "batch window for joint call assignment"},
+        {"dd-span", 'd', CONFIG_INT, &g_dd_span, NULL, 0, -1, INT_MAX, "destination dispatch grouping span in floors"},
+        {"follow-port", 'f', CONFIG_INT, &g_follow_port, NULL, 0, 0, NET_PORT_MAX, "run as hot standby to the primary replicating on this port"},
+        {"journal", 'j', CONFIG_STRING, &g_journal_path, NULL, 0, 0, 0, "append-only trip journal"},
+        {"park-idle-ms", 'p', CONFIG_UNSIGNED, &g_park_idle_ms, NULL, 0, 0, 0, "idle time before cars are parked at busy floors"},
+        {"listen", 0, CONFIG_STRING, &g_listen_host, NULL, 0, 0, 0, "address to serve cars and call pads on"},
+        {"port", 'P', CONFIG_INT, &g_ctrl_port, NULL, 0, 1, NET_PORT_MAX, "port to serve cars and call pads on"},
+        {"acceptors", 0, CONFIG_INT, &g_acceptors, NULL, 0, 1, MAX_ACCEPTORS, "acceptor threads, each with its own listener pinned to a core"},
+        {"workers", 0, CONFIG_INT, &g_pool_workers, NULL, 0, 1, INT_MAX, "worker threads handling new connections"},
+        {"queue-depth", 0, CONFIG_INT, &g_pool_depth, NULL, 0, 1, INT_MAX, "connections queued for the workers before accepts wait"},
+        {"max-inflight", 0, CONFIG_INT, &g_max_inflight, NULL, 0, 0, INT_MAX, "calls answered at once before new calls get BUSY (0 for no bound)"},
+        {"max-queue-ms", 0, CONFIG_INT, &g_max_queue_ms, NULL, 0, 0, INT_MAX, "longest a call waits for a worker before it gets BUSY (0 for no bound)"},
+        {"call-rate", 0, CONFIG_UNSIGNED, &g_call_rate, NULL, 0, 0, 0, "calls per second each source floor may make (0 for no limit)"},
+        {"call-burst", 0, CONFIG_INT, &g_call_burst, NULL, 0, 1, INT_MAX, "calls a source floor may make at once above its rate"},
+        {"repl-host", 0, CONFIG_STRING, &g_repl_host, NULL, 0, 0, 0, "address of the replication stream"},
+        {"repl-port", 'r', CONFIG_INT, &g_repl_port, NULL, 0, 0, NET_PORT_MAX, "port a hot standby connects on"},
+        {"snapshot", 's', CONFIG_STRING, &g_snapshot_path, NULL, 0, 0, 0, "registry snapshot file for crash recovery"},
+        {"traffic-dump", 't', CONFIG_STRING, &g_traffic_dump_path, NULL, 0, 0, 0, "file the traffic counters are dumped to on SIGUSR1"},
+        {"peer-host", 0, CONFIG_STRING, &g_peer_host, NULL, 0, 0, 0, "address of the peer zone controllers"},
+        {"peer", 'z', CONFIG_INT_LIST, g_peer_ports, &g_n_peers, MAX_PEERS, 1, NET_PORT_MAX, "peer zone controller port (repeatable)"},
+        {"peer-timeout-ms", 0, CONFIG_INT, &g_peer_timeout_ms, NULL, 0, 0, INT_MAX, "longest a forwarded call waits on a peer per connect, send or reply"},
+        NET_CONFIG_OPTIONS(g_net),
+        LOG_CONFIG_OPTIONS(g_log_level_name, g_log_stamp),
+    };
+    int n_opts = (int)(sizeof opts / sizeof opts[0]);
+    if (config_parse(opts, n_opts, argc, argv, NULL, 0) == -1)
     {
-        perror("Socket Error"); 
+        config_usage(stderr, argv[0], NULL, opts, n_opts);
+        return 1;
+    }
+    // Log through the background flusher from here on
+    log_level_t log_level;
+    if (log_level_parse(g_log_level_name, &log_level) == -1 || log_init(log_level, g_log_stamp) == -1)
+    {
+        fprintf(stderr, "Invalid log level: %s\n", g_log_level_name);
         return 1;
     }
 
-    // Signal handling
-    signal(SIGPIPE, SIG_IGN);
+    // A standby mirrors the primary and only starts serving once it is gone
+    if (g_follow_port > 0)
+    {
+        standby_follow();
+    }
 
-    
-    int enable_reuse = 1;
-    // Allow port reuse directly after termination
-    setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &enable_reuse, sizeof(enable_reuse));
-
-    // Initialise network address
-    struct sockaddr_in addr;
-    memset(&addr, 0, sizeof addr);
-    addr.sin_family = AF_INET;
-    addr.sin_port= htons(CTRL_PORT);
-    addr.sin_addr.s_addr = INADDR_ANY;
-    // Attempt connect
-    if (bind(s, (struct sockaddr*)&addr, sizeof addr) == -1) 
-    {
-        perror("Bind error");
-        close(s);
+    // Open the journal after any takeover so appends continue the primary's
+    if (g_journal_path && journal_open(g_journal_path, JOURNAL_CAPACITY) == -1)
+    {
+        perror("Journal error");
         return 1;
     }
-    if (listen(s, 16) == -1) {
-        perror("Listening Erorr");
-        close(s);
-        return 1;
-    }  signal(SIGPIPE, SIG_IGN);
 
-    // Connection loop
-    for (;;)
+    // Start forecasting from empty counters that halve daily
+    traffic_init(86400.0, now_ms());
+
+    // Journal trip progress reported by the dispatcher
+    dispatch_set_trip_hook(journal_trip);
+
+    // Dump traffic counters from a dedicated thread on SIGUSR1
+    static sigset_t dump_set;
+    if (g_traffic_dump_path)
     {
-        // Initialise the client client connection
-        struct sockaddr_in client_addr;
-        socklen_t client_len = sizeof(client_addr);
-        // Wait for request and attempt accept
-        int client_socket = accept(s, (struct sockaddr*)&client_addr, &client_len);
-        if (client_socket == -1)
+        // Block the signal before other threads start so they inherit the mask
+        sigemptyset(&dump_set);
+        sigaddset(&dump_set, SIGUSR1);
+        pthread_sigmask(SIG_BLOCK, &dump_set, NULL);
+
+        pthread_t dump_tid;
+        if (pthread_create(&dump_tid, NULL, traffic_dump_thread, &dump_set) != 0)
         {
-            perror("Accepting Error");
-            break;
+            perror("Pthread_create Error");
+            return 1;
         }
+        pthread_detach(dump_tid);
+    }
 
-        // Allocate memory to pass arguement to thread
-        tcp_args_t* args = (tcp_args_t*)malloc(sizeof *args);
-        if(!args)
+    // Warm start from the last snapshot, unless the primary's state was taken over
+    if (g_snapshot_path)
+    {
+        if (snapshot_open(g_snapshot_path) == -1)
         {
-            close(client_socket);
-            continue;
+            perror("Snapshot error");
+            return 1;
+        }
+        if (g_follow_port == 0)
+        {
+            // Queues are handed back to cars as they re-register
+            g_recovered_len = snapshot_load(g_recovered);
+            g_recovered_until_ms = now_ms() + RECOVERY_GRACE_MS;
         }
+    }
 
-        // Store client file descriptor in memory
-        args->socket_fd = client_socket;
+    // Keep the snapshot current and expire recovered cars
+    if (g_snapshot_path || g_follow_port > 0)
+    {
+        pthread_t snapshot_tid;
+        if (pthread_create(&snapshot_tid, NULL, snapshot_thread, NULL) != 0)
+        {
+            perror("Pthread_create Error");
+            return 1;
+        }
+        pthread_detach(snapshot_tid);
+    }
 
-        // Create thread for the client
-        pthread_t th;
-        if (pthread_create(&th, NULL, tcp_thread, args) != 0) 
+    // Start the parking thread when parking is enabled
+    if (g_park_idle_ms > 0)
+    {
+        pthread_t park_tid;
+        if (pthread_create(&park_tid, NULL, park_thread, NULL) != 0)
         {
             perror("Pthread_create Error");
-            close(client_socket);
-            free(args);
-            continue;
+            return 1;
         }
-        // Detach the thread
-        pthread_detach(th);
+        pthread_detach(park_tid);
+    }
+
+    // Start the batch thread when a batch window is configured
+    if (g_batch_window_ms > 0)
+    {
+        // The window deadline is measured on the monotonic clock
+        pthread_condattr_t cond_var;
+        pthread_condattr_init(&cond_var);
+        pthread_condattr_setclock(&cond_var, CLOCK_MONOTONIC);
+        pthread_cond_init(&g_batch_cv, &cond_var);
+        pthread_condattr_destroy(&cond_var);
+
+        pthread_t batch_tid;
+        if (pthread_create(&batch_tid, NULL, batch_thread, NULL) != 0)
+        {
+            perror("Pthread_create Error");
+            return 1;
+        }
+        pthread_detach(batch_tid);
+    }
+
+    // Stream registry changes to a standby
+    static int repl_socket = -1;
+    if (g_repl_port > 0)
+    {
+        repl_socket = net_listen(&g_net, g_repl_host, g_repl_port);
+        if (repl_socket == -1)
+        {
+            perror("Replication error");
+            return 1;
+        }
+        pthread_t repl_tid;
+        if (pthread_create(&repl_tid, NULL, repl_thread, &repl_socket) != 0)
+        {
+            perror("Pthread_create Error");
+            return 1;
+        }
+        pthread_detach(repl_tid);
+    }
+
+    // Signal handling
+    signal(SIGPIPE, SIG_IGN);
+
+    // Bound calls in flight, their wait for a worker and the rate of each source floor
+    admit_init(g_max_inflight, g_max_queue_ms, (double)g_call_rate, g_call_burst);
+
+    // Handle new connections on a fixed pool of workers
+    if (pool_start(g_pool_workers, g_pool_depth, tcp_connection) == -1)
+    {
+        fprintf(stderr, "Unable to start %d workers with a queue of %d.\n", g_pool_workers, g_pool_depth);
+        return 1;
+    }
+
+    // Listen for cars and call pads. Several acceptors each bind their own
+    // SO_REUSEPORT listener so the kernel spreads connections across them.
+    // The options table holds g_acceptors to 1..MAX_ACCEPTORS
+    static acceptor_t acceptors[MAX_ACCEPTORS];
+    net_config_t listen_cfg = g_net;
+    listen_cfg.reuseport = g_net.reuseport || g_acceptors > 1;
+    for (int a = 0; a < g_acceptors; ++a)
+    {
+        acceptors[a].listen_fd = net_listen(&listen_cfg, g_listen_host, g_ctrl_port);
+        if (acceptors[a].listen_fd == -1)
+        {
+            perror("Listening Error");
+            return 1;
+        }
+        // A single acceptor is left to the scheduler
+        acceptors[a].cpu = g_acceptors > 1 ? a : -1;
+    }
+    // The main thread runs the first acceptor
+    for (int a = 1; a < g_acceptors; ++a)
+    {
+        pthread_t acceptor_tid;
+        if (pthread_create(&acceptor_tid, NULL, acceptor_thread, &acceptors[a]) != 0)
+        {
+            perror("Pthread_create Error");
+            return 1;
+        }
+        pthread_detach(acceptor_tid);
+    }
+    (void)acceptor_thread(&acceptors[0]);
+
+    // Gracefully close the listeners, journal and snapshot
+    for (int a = 0; a < g_acceptors; ++a)
+    {
+        close(acceptors[a].listen_fd);
     }
-    // Gracefully close the socket
-    close(s);
+    journal_close();
+    snapshot_close();
     //success
     return 0;
 }
@@ -0,0 +1,645 @@
+// Author: Alexandros Sacranie
+// Module: Safety Critical Monitor (dispatch.c)
+// Project: Distributed Elevator Control System
+
+/* Dispatch logic shared by the controller and the offline replay tool
+
+    Nothing here reads a clock or touches a socket: callers pass the current
+    time and traffic slot in and hold whatever lock guards the cars. The only
+    lock taken is the traffic counters' own, briefly, when car_cost reads a
+    floor's share of the demand.
+    Trip progress is reported through a hook so the controller can journal it
+    and the replay tool can measure it.
+*/
+
+#include "dispatch.h"
+#include "traffic.h"
+#include "parse_util.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Receives trip events (NULL when nobody is listening)
+static trip_hook_fn g_trip_hook = NULL;
+
+void dispatch_set_trip_hook(trip_hook_fn hook)
+{
+    g_trip_hook = hook;
+}
+
+//                  Queue Operations                    //
+
+bool in_queue(const CarID* car, int fnum)
+{
+    // Loop through queue length to find floor
+    for (int i = 0; i < car->queue_len; ++i)
+    {
+        if (car->q[i] == fnum)
+        {
+            // if floor found return true
+            return true;
+        }
+    }
+
+    // Otherwise return false
+    return false;
+}
+
+void queue_floor(CarID* car, int fnum)
+{
+    // Check to ensure there is space in the queue
+    if (car->queue_len < MAX_QUEUE)
+    {
+        // If there is space add floor to queue
+        car->q[car->queue_len++] = fnum;
+    }
+}
+
+void dequeue_floor(CarID* car)
+{
+    // Check to ensure there is something to dequeue
+    if (car->queue_len <= 0)
+    {
+        // if not return early
+        return;
+    }
+    // Shift all floors forward in the queue
+    for (int i = 1; i < car->queue_len; ++i)
+    {
+        car->q[i-1] = car->q[i];
+    }
+    // Decrease queue length
+    car->queue_len--;
+}
+
+void enqueue(CarID* car, int src_floor, int dst_floor)
+{
+    // Check to ensure car is valid and is able to add to queue
+    if (!car || src_floor == dst_floor)
+    {
+        return;
+    }
+    // Work takes the car away from its parking floor, even if the trip
+    // finishes before the parking pass next looks at the car
+    car->park_floor = 0;
+
+    // Check to make sure source floor is not already in queue
+    if (!in_queue(car, src_floor))
+    {
+        // Add source floor to queue
+        queue_floor(car, src_floor);
+    }
+
+    // Ensure destination floor is after source floor in queue
+    int src_index = -1, dst_index = -1;
+    for (int i = 0; i < car->queue_len; ++i)
+    {
+        // Find the indexes of source and destination floors
+        if (car->q[i] == src_floor && src_index < 0)
+        {
+            // Store source index
+            src_index = i;
+        }
+        if (car->q[i] == dst_floor && dst_index < 0)
+        {
+            // Store destination index
+            dst_index = i;
+        }
+    }
+    // Check if destination is before source
+    if (dst_index >= 0 && dst_index < src_index)
+    {
+        // If destination is before source remove destination from queue
+        for (int i = dst_index + 1; i < car->queue_len; ++i)
+        {
+            car->q[i-1] = car->q[i];
+        }
+        // Decrease queue length and reset destination index
+        car->queue_len--;
+        dst_index = -1;
+    }
+    // If destination is not in queue add to end of queue
+    if (dst_index < 0)
+    {
+        queue_floor(car, dst_floor);
+    }
+}
+
+
+//                  Kinematic Model                 //
+
+long floor_distance(int from, int to)
+{
+    // Count the floors travelled between two floors
+    long d = (from > to) ? (long)from - to : (long)to - from;
+    // There is no floor 0 so crossing from the basement saves a floor
+    if ((from < 0) != (to < 0))
+    {
+        d--;
+    }
+    return d;
+}
+
+static void model_observe(CarID* car, const char* status, long now)
+{
+    // Only status transitions carry timing information
+    if (strcmp(car->status, status) == 0)
+    {
+        return;
+    }
+    // Record how long the car spent in the status it is leaving
+    timing_record(&car->timing, timing_kind(car->status), now - car->state_since_ms);
+    // A door cycle runs from Opening until the doors are Closed again
+    if (strcmp(status, "Opening") == 0 && car->door_since_ms < 0)
+    {
+        car->door_since_ms = now;
+    }
+    else if (strcmp(status, "Closed") == 0)
+    {
+        car->door_since_ms = -1;
+    }
+    // Record when the new status began
+    car->state_since_ms = now;
+}
+
+void car_model_reset(CarID* car, long now)
+{
+    // Start the kinematic model from default timings
+    timing_init(&car->timing, DEFAULT_FLOOR_MS, DEFAULT_DOOR_MS);
+    car->state_since_ms = now;
+    car->door_since_ms = -1;
+    route_refresh(car, now);
+    car->park_floor = 0;
+    car->trip_count = 0;
+}
+
+void car_observe(CarID* car, const char* status, const char* cur, const char* dst, long now)
+{
+    // Learn timings from the transition before storing it
+    model_observe(car, status, now);
+    // Update car status
+    strncpy(car->status, status, sizeof car->status - 1);
+    // Update current and destination floors
+    strncpy(car->cur_floor, cur, sizeof car->cur_floor - 1);
+    strncpy(car->dst_floor, dst, sizeof car->dst_floor - 1);
+    // Re-estimate the route from the new position
+    route_refresh(car, now);
+}
+
+void route_refresh(CarID* car, long now)
+{
+    // Start from the car's last reported floor
+    int pos;
+    if (!floor_num_handler(car->cur_floor, &pos))
+    {
+        pos = car->lowest_floor;
+    }
+    long t = 0;
+    // Account for the movement or door cycle already underway
+    if (strcmp(car->status, "Between") == 0)
+    {
+        // The floor being travelled is counted below so credit the time spent on it
+        long elapsed = now - car->state_since_ms;
+        t = -(elapsed < car->timing.floor_ms ? elapsed : car->timing.floor_ms);
+    }
+    else if (car->door_since_ms >= 0)
+    {
+        long left = car->timing.door_ms - (now - car->door_since_ms);
+        t = left > 0 ? left : 0;
+    }
+    // Accumulate the arrival time at each queued stop
+    for (int i = 0; i < car->queue_len; ++i)
+    {
+        t += car->timing.floor_ms * floor_distance(pos, car->q[i]);
+        car->eta_ms[i] = t;
+        t += car->timing.door_ms;
+        pos = car->q[i];
+    }
+    // Store where and when the route ends for appended stops
+    car->route_end_ms = t;
+    car->route_end_floor = pos;
+    car->route_base_ms = now;
+}
+
+long car_eta_ms(const CarID* car, int floor, long now)
+{
+    long eta = -1;
+    // Use the cached arrival time if the floor is already a stop
+    for (int i = 0; i < car->queue_len; ++i)
+    {
+        if (car->q[i] == floor)
+        {
+            eta = car->eta_ms[i];
+            break;
+        }
+    }
+    // Otherwise the floor is appended to the end of the route
+    if (eta < 0)
+    {
+        eta = car->route_end_ms + car->timing.floor_ms * floor_distance(car->route_end_floor, floor);
+    }
+    // Remove the time passed since the route was cached
+    eta -= now - car->route_base_ms;
+    return eta > 0 ? eta : 0;
+}
+
+//                  Trip Tracking                 //
+
+void trip_assign(CarID* car, uint32_t trip_id, int src_floor, int dst_floor, long eta)
+{
+    trip_t t = {trip_id, src_floor, dst_floor, false};
+    // Report the assignment
+    if (g_trip_hook)
+    {
+        g_trip_hook(TRIP_ASSIGN, car, &t, eta);
+    }
+    // Track the trip until it is dropped off
+    if (car->trip_count < MAX_QUEUE)
+    {
+        car->trips[car->trip_count++] = t;
+    }
+}
+
+static void trip_serve(CarID* car, int floor)
+{
+    // Check every open trip against the floor the car opened at
+    int kept = 0;
+    for (int i = 0; i < car->trip_count; ++i)
+    {
+        trip_t t = car->trips[i];
+        if (!t.picked_up && t.src_floor == floor)
+        {
+            // Passenger boards at the source floor
+            if (g_trip_hook)
+            {
+                g_trip_hook(TRIP_PICKUP, car, &t, 0);
+            }
+            t.picked_up = true;
+        }
+        else if (t.picked_up && t.dst_floor == floor)
+        {
+            // Passenger leaves at the destination and the trip is complete
+            if (g_trip_hook)
+            {
+                g_trip_hook(TRIP_DROPOFF, car, &t, 0);
+            }
+            continue;
+        }
+        car->trips[kept++] = t;
+    }
+    car->trip_count = kept;
+}
+
+bool car_schedule(CarID* car, long now)
+{
+    // Make sure the queue length is greater than 0
+    if (car->queue_len > 0)
+    {
+        // Capture the head of the queue
+        char head_str[4];
+        index_handler(car->q[0], head_str);
+        // If the car is the desitnation floor and has a status of Opening dequeue it
+        if (strcmp(car->status, "Opening") == 0 && strcmp(car->cur_floor, head_str) == 0)
+        {
+            // Floor has been serviced
+            trip_serve(car, car->q[0]);
+            dequeue_floor(car);
+            route_refresh(car, now);
+        }
+    }
+    // Return whether there are still floors in the queue
+    return car->queue_len > 0;
+}
+
+//                  Car Selection                  //
+
+bool can_service(const CarID* car, int src_floor, int dst_floor)
+{
+    // Check to make sure car is valid and in use
+    if (!car || !car->in_use)
+    {
+        return false;
+    }
+    // Check to make sure source floor is within the cars service range
+    if (src_floor < car->lowest_floor || src_floor > car->highest_floor)
+    {
+        return false;
+    }
+    // Check to make sure destination floor is within the cars service range
+    if (dst_floor < car->lowest_floor || dst_floor > car->highest_floor)
+    {
+        return false;
+    }
+
+    // Car can service the requested trip
+    return true;
+}
+
+static bool same_direction(int src_floor, int a, int b)
+{
+    // Both trips leave the source floor the same way
+    return (a > src_floor) == (b > src_floor);
+}
+
+bool dd_match(const CarID* car, int src_floor, int dst_floor, int dd_span)
+{
+    // Find a pending pickup at the source floor
+    int src_index = -1;
+    for (int i = 0; i < car->queue_len; ++i)
+    {
+        if (car->q[i] == src_floor)
+        {
+            src_index = i;
+            break;
+        }
+    }
+    if (src_index < 0)
+    {
+        return false;
+    }
+    // Check for a queued stop after the pickup close to the destination
+    for (int i = src_index + 1; i < car->queue_len; ++i)
+    {
+        if (same_direction(src_floor, car->q[i], dst_floor) &&
+            floor_distance(car->q[i], dst_floor) <= dd_span)
+        {
+            // Passenger can ride with the group already on this car
+            return true;
+        }
+    }
+    return false;
+}
+
+int select_car(const CarID cars[], int n_cars, int src_floor, int dst_floor, int dd_span, long now, int slot)
+{
+    // In destination dispatch mode prefer a car already collecting a group
+    // at the source floor heading near the same destination
+    for (int i = 0; dd_span >= 0 && i < n_cars; ++i)
+    {
+        if (can_service(&cars[i], src_floor, dst_floor) && dd_match(&cars[i], src_floor, dst_floor, dd_span))
+        {
+            return i;
+        }
+    }
+    // Otherwise take the cheapest car by its learned timings, the first on a tie
+    int best = -1;
+    long best_cost = COST_INFEASIBLE;
+    for (int i = 0; i < n_cars; ++i)
+    {
+        long cost = car_cost(&cars[i], src_floor, dst_floor, now, slot);
+        if (cost < best_cost)
+        {
+            best = i;
+            best_cost = cost;
+        }
+    }
+    // Return the car (-1 when no car can service the trip)
+    return best;
+}
+
+//                  Batch Assignment                  //
+
+long car_cost(const CarID* car, int src_floor, int dst_floor, long now, int slot)
+{
+    // Cars that cannot service the trip are never chosen
+    if (!can_service(car, src_floor, dst_floor))
+    {
+        return COST_INFEASIBLE;
+    }
+    // Otherwise the cost is the estimated time to reach the source floor
+    long cost = car_eta_ms(car, src_floor, now);
+    // An idle car waiting at a busy floor is likely to be needed there soon
+    int cur;
+    if (car->queue_len == 0 && floor_num_handler(car->cur_floor, &cur) && cur != src_floor)
+    {
+        double share = traffic_origin_share(cur, slot);
+        cost += (long)(share * (double)(HOLD_FLOORS * car->timing.floor_ms));
+    }
+    return cost;
+}
+
+// Cost matrix for the batch assignment, one row per call group and one
+// column per car slot
+static long g_assign_cost[MAX_BATCH][MAX_CARS * MAX_BATCH];
+
+static void min_cost_assignment(int rows, int cols, int row_to_col[])
+{
+    // Hungarian algorithm (shortest augmenting path with potentials) over
+    // g_assign_cost, requires rows <= cols. Arrays are 1-indexed with
+    // column 0 used as the augmenting path root.
+    static long u[MAX_BATCH + 1], v[MAX_CARS * MAX_BATCH + 1], minv[MAX_CARS * MAX_BATCH + 1];
+    static int  p[MAX_CARS * MAX_BATCH + 1], way[MAX_CARS * MAX_BATCH + 1];
+    static bool used[MAX_CARS * MAX_BATCH + 1];
+
+    // Reset potentials and matching
+    for (int i = 0; i <= rows; ++i)
+    {
+        u[i] = 0;
+    }
+    for (int j = 0; j <= cols; ++j)
+    {
+        v[j] = 0;
+        p[j] = 0;
+    }
+
+    // Add one row at a time to the matching
+    for (int i = 1; i <= rows; ++i)
+    {
+        p[0] = i;
+        int j0 = 0;
+        for (int j = 0; j <= cols; ++j)
+        {
+            minv[j] = LONG_MAX;
+            used[j] = false;
+        }
+        // Grow the alternating tree until a free column is reached
+        do
+        {
+            used[j0] = true;
+            int i0 = p[j0], j1 = 0;
+            long delta = LONG_MAX;
+            for (int j = 1; j <= cols; ++j)
+            {
+                if (used[j])
+                {
+                    continue;
+                }
+                long cur = g_assign_cost[i0 - 1][j - 1] - u[i0] - v[j];
+                if (cur < minv[j])
+                {
+                    minv[j] = cur;
+                    way[j] = j0;
+                }
+                if (minv[j] < delta)
+                {
+                    delta = minv[j];
+                    j1 = j;
+                }
+            }
+            // Update potentials along the tree
+            for (int j = 0; j <= cols; ++j)
+            {
+                if (used[j])
+                {
+                    u[p[j]] += delta;
+                    v[j] -= delta;
+                }
+                else
+                {
+                    minv[j] -= delta;
+                }
+            }
+            j0 = j1;
+        } while (p[j0] != 0);
+        // Flip the augmenting path
+        do
+        {
+            int j1 = way[j0];
+            p[j0] = p[j1];
+            j0 = j1;
+        } while (j0 != 0);
+    }
+
+    // Read the matching back out per row
+    for (int j = 1; j <= cols; ++j)
+    {
+        if (p[j] != 0)
+        {
+            row_to_col[p[j] - 1] = j - 1;
+        }
+    }
+}
+
+static bool same_cars(const CarID cars[], int n_cars, const dispatch_call_t* a, const dispatch_call_t* b)
+{
+    // Both calls can be served by exactly the same cars
+    for (int i = 0; i < n_cars; ++i)
+    {
+        if (can_service(&cars[i], a->src_floor, a->dst_floor) != can_service(&cars[i], b->src_floor, b->dst_floor))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int group_calls(const CarID cars[], int n_cars, const dispatch_call_t* calls, int n, int dd_span, int group[], int lead[])
+{
+    int groups = 0;
+    for (int c = 0; c < n; ++c)
+    {
+        group[c] = -1;
+        // In destination dispatch mode join the first group from the same
+        // floor travelling the same way to a nearby destination. Only calls
+        // the same cars can serve share a group, so a member outside one
+        // car's range never makes the whole group infeasible for it.
+        for (int g = 0; dd_span >= 0 && g < groups; ++g)
+        {
+            const dispatch_call_t* l = &calls[lead[g]];
+            if (l->src_floor == calls[c].src_floor &&
+                same_direction(l->src_floor, l->dst_floor, calls[c].dst_floor) &&
+                floor_distance(l->dst_floor, calls[c].dst_floor) <= dd_span &&
+                same_cars(cars, n_cars, l, &calls[c]))
+            {
+                group[c] = g;
+                break;
+            }
+        }
+        // Otherwise the call starts its own group
+        if (group[c] < 0)
+        {
+            lead[groups] = c;
+            group[c] = groups++;
+        }
+    }
+    // Return number of groups
+    return groups;
+}
+
+void batch_assign(CarID cars[], int n_cars, const dispatch_call_t calls[], int n, int dd_span, long now, int slot, int out_car[])
+{
+    int slot_car[MAX_CARS * MAX_BATCH];
+    int row_to_col[MAX_BATCH];
+    int group[MAX_BATCH], lead[MAX_BATCH], order[MAX_BATCH];
+    bool touched[MAX_CARS] = {false};
+    int cols = 0;
+
+    // Assign groups of calls rather than single calls so each group rides one car
+    int groups = group_calls(cars, n_cars, calls, n, dd_span, group, lead);
+
+    // Enqueue order is by group then nearest destination first, so a group's
+    // stops are visited in travel order
+    for (int c = 0; c < n; ++c)
+    {
+        int k = c;
+        while (k > 0)
+        {
+            const dispatch_call_t* a = &calls[order[k - 1]];
+            int ga = group[order[k - 1]];
+            if (ga < group[c] || (ga == group[c] &&
+                floor_distance(a->src_floor, a->dst_floor) <= floor_distance(calls[c].src_floor, calls[c].dst_floor)))
+            {
+                break;
+            }
+            order[k] = order[k - 1];
+            k--;
+        }
+        order[k] = c;
+    }
+
+    // Give every car one column per group so a car can take several groups
+    // from the same batch; each extra group on a car pays for the stops it adds
+    for (int i = 0; i < n_cars; ++i)
+    {
+        if (!cars[i].in_use)
+        {
+            continue;
+        }
+        for (int g = 0; g < groups; ++g)
+        {
+            // The group is costed by its lead call; every member fits the
+            // same cars as the lead
+            long base = car_cost(&cars[i], calls[lead[g]].src_floor, calls[lead[g]].dst_floor, now, slot);
+            for (int k = 0; k < groups; ++k)
+            {
+                g_assign_cost[g][cols + k] = (base >= COST_INFEASIBLE) ? COST_INFEASIBLE : base + (long)k * 2 * cars[i].timing.door_ms;
+            }
+        }
+        for (int k = 0; k < groups; ++k)
+        {
+            slot_car[cols++] = i;
+        }
+    }
+
+    // Solve the batch jointly when any car is registered
+    if (cols > 0)
+    {
+        min_cost_assignment(groups, cols, row_to_col);
+    }
+
+    // Queue each call on the car assigned to its group
+    for (int k = 0; k < n; ++k)
+    {
+        int c = order[k];
+        int g = group[c];
+        out_car[c] = -1;
+        if (cols == 0 || g_assign_cost[g][row_to_col[g]] >= COST_INFEASIBLE)
+        {
+            continue;
+        }
+        int idx = slot_car[row_to_col[g]];
+        enqueue(&cars[idx], calls[c].src_floor, calls[c].dst_floor);
+        out_car[c] = idx;
+        touched[idx] = true;
+    }
+    // Re-estimate the routes of cars that received work
+    for (int i = 0; i < n_cars; ++i)
+    {
+        if (touched[i])
+        {
+            route_refresh(&cars[i], now);
+        }
+    }
+}
@@ -0,0 +1,118 @@
+#ifndef DISPATCH_H
+#define DISPATCH_H
+
+#include "shared.h"
+#include "timing.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Registry and batch sizing
+#define MAX_CARS 16
+#define MAX_QUEUE 32
+#define MAX_BATCH 32
+
+// Until a car has been observed assume the car's default delay of one
+// second per floor and per door state (Opening, Open, Closing)
+#define DEFAULT_FLOOR_MS 1000L
+#define DEFAULT_DOOR_MS 3000L
+// Dispatch cost of a car that cannot service a trip
+#define COST_INFEASIBLE 1000000000L
+// Floors of travel charged for pulling an idle car away from a floor that
+// originates all of the current slot's calls (scaled by the floor's share)
+#define HOLD_FLOORS 4L
+
+// A trip a car has been assigned but not completed
+typedef struct {
+  uint32_t id;                     // Trip id the call was journalled under
+  int src_floor, dst_floor;        // Pickup and drop-off floors
+  bool picked_up;                  // Passenger has boarded
+} trip_t;
+
+// Dispatcher view of one car
+typedef struct {
+  int in_use;                      // Slot holds a registered car
+  int shm_fd;                      // Controller-side shm descriptor (-1 if none)
+  int socket_fd;                   // Car connection (-1 when simulated)
+  char name[32];                   // Car name
+  int lowest_floor, highest_floor; // Service range
+  int q[MAX_QUEUE];                // Queued stops, head first
+  int queue_len;                   // Stops in the queue
+  char status[16];                 // Last reported status
+  char cur_floor[4];               // Last reported current floor
+  char dst_floor[4];               // Last reported destination floor
+  car_shared_mem* shm_ptr;         // Controller-side shm mapping (NULL if none)
+  car_timing_t timing;             // Learned floor and door cycle timings
+  long state_since_ms;             // When the current status began
+  long door_since_ms;              // When the door cycle began (-1 if closed)
+  long eta_ms[MAX_QUEUE];          // Arrival at each stop relative to route_base_ms
+  long route_end_ms, route_base_ms;// Route end time and when it was cached
+  int route_end_floor;             // Floor the route ends on
+  int park_floor;                  // Floor last sent to park at (0 if not parked)
+  trip_t trips[MAX_QUEUE];         // Trips awaiting pickup or drop-off
+  int trip_count;                  // Trips in trips[]
+} CarID;
+
+// A call waiting to be assigned by batch_assign
+typedef struct {
+  int src_floor;                   // Floor the passenger calls from
+  int dst_floor;                   // Floor the passenger travels to
+} dispatch_call_t;
+
+// Trip progress reported to the owner of the dispatcher
+typedef enum
+{
+    TRIP_ASSIGN,
+    TRIP_PICKUP,
+    TRIP_DROPOFF
+} trip_event_t;
+
+// Called on every trip event (eta_ms is only set for TRIP_ASSIGN)
+typedef void (*trip_hook_fn)(trip_event_t event, const CarID* car, const trip_t* trip, long eta_ms);
+
+// Install the trip event hook (NULL disables it)
+void dispatch_set_trip_hook(trip_hook_fn hook);
+
+// Queue operations
+bool in_queue(const CarID* car, int fnum);
+void queue_floor(CarID* car, int fnum);
+void dequeue_floor(CarID* car);
+void enqueue(CarID* car, int src_floor, int dst_floor);
+
+// Floors travelled between two floors (there is no floor 0)
+long floor_distance(int from, int to);
+
+// Reset the kinematic model and trips of a newly registered car
+void car_model_reset(CarID* car, long now);
+
+// Store a STATUS report, learning timings from the transition
+void car_observe(CarID* car, const char* status, const char* cur, const char* dst, long now);
+
+// Re-estimate the arrival time at every queued stop
+void route_refresh(CarID* car, long now);
+
+// Estimated time until the car reaches a floor
+long car_eta_ms(const CarID* car, int floor, long now);
+
+// Dequeue the head when the car opens at it; returns true while work remains
+bool car_schedule(CarID* car, long now);
+
+// Track a trip on the car it was assigned to
+void trip_assign(CarID* car, uint32_t trip_id, int src_floor, int dst_floor, long eta);
+
+// Car checks
+bool can_service(const CarID* car, int src_floor, int dst_floor);
+bool dd_match(const CarID* car, int src_floor, int dst_floor, int dd_span);
+
+// Car to take the trip: one collecting a destination dispatch group when
+// dd_span >= 0, otherwise the lowest car_cost (-1 when no car can)
+int select_car(const CarID cars[], int n_cars, int src_floor, int dst_floor, int dd_span, long now, int slot);
+
+// Cost of adding a trip to a car (COST_INFEASIBLE if it cannot take it)
+long car_cost(const CarID* car, int src_floor, int dst_floor, long now, int slot);
+
+// Jointly assign a batch of calls and enqueue them; out_car[c] receives the
+// car index of call c or -1. Not reentrant (one batch at a time).
+void batch_assign(CarID cars[], int n_cars, const dispatch_call_t calls[], int n, int dd_span, long now, int slot, int out_car[]);
+
+#endif // DISPATCH_H
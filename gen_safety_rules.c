@@ -0,0 +1,87 @@
+// Author: Alexandros Sacranie
+// Module: Safety Critical Monitor (gen_safety_rules.c)
+// Project: Distributed Elevator Control System
+
+/* Safety rule compiler
+
+    Evaluates safety_rules.def for every state and input combination and
+    writes the outcomes as a C lookup table, so the monitor validates a
+    sample of shared memory with one table read instead of walking the
+    rules. Run by make; the output is safety_rules.h.
+*/
+
+#include "safety_model.h"
+
+#include <stddef.h>
+#include <stdio.h>
+
+// Structure to hold one rule from the definition file
+typedef struct
+{
+    const char* name;
+    unsigned states;
+    unsigned inputs_set;
+    unsigned inputs_clear;
+    unsigned actions;
+} rule_t;
+
+static const rule_t g_rules[] = {
+#define SAFETY_RULE(name, states, set, clear, actions, message) {#name, (states), (set), (clear), (actions)},
+#include "safety_rules.def"
+#undef SAFETY_RULE
+};
+
+#define N_RULES (sizeof g_rules / sizeof g_rules[0])
+
+static unsigned evaluate(unsigned state, unsigned inputs)
+{
+    unsigned entry = 0;
+    for (unsigned r = 0; r < N_RULES; ++r)
+    {
+        const rule_t* rule = &g_rules[r];
+        // Skip rules whose state or inputs do not match
+        if (!(rule->states & (1u << state)) ||
+            (inputs & rule->inputs_set) != rule->inputs_set ||
+            (inputs & rule->inputs_clear) != 0)
+        {
+            continue;
+        }
+        // Reopening changes the state later rules see
+        if (rule->actions & ACT_REOPEN)
+        {
+            entry |= SAFETY_ENTRY_REOPEN;
+            state = SAFETY_OPENING;
+        }
+        // Entering emergency mode ends the evaluation
+        if (rule->actions & ACT_EMERGENCY)
+        {
+            entry |= r + 1u;
+            break;
+        }
+    }
+    return entry;
+}
+
+int main(void)
+{
+    printf("// Generated by gen_safety_rules from safety_rules.def; do not edit.\n\n");
+    printf("#ifndef SAFETY_RULES_H\n#define SAFETY_RULES_H\n\n");
+    printf("#include \"safety_model.h\"\n\n");
+    // Table of outcomes for every state and input combination
+    printf("static const uint8_t g_safety_table[SAFETY_KEYS] = {\n");
+    static const char* const state_names[SAFETY_STATES] = {
+        "Closed", "Opening", "Open", "Closing", "Between", "invalid status"
+    };
+    for (unsigned state = 0; state < SAFETY_STATES; ++state)
+    {
+        printf("    // %s\n", state_names[state]);
+        for (unsigned inputs = 0; inputs < (1u << SAFETY_INPUT_BITS); ++inputs)
+        {
+            // Sixteen entries to a row
+            printf("%s0x%02x,%s", inputs % 16u == 0 ? "    " : "", evaluate(state, inputs),
+                   inputs % 16u == 15u ? "\n" : " ");
+        }
+    }
+    printf("};\n\n#endif // SAFETY_RULES_H\n");
+    return 0;
+}
@@ -11,67 +11,8 @@
 #include <pthread.h>
 #include <stdint.h>
 #include "shared.h"
-
-//                  Floor Handlers                  //
-// floor_num_handler and index_handler reused from controller.c
-
-static int floor_num_handler(const char *f, int *out)
-{
-    // Check to ensure that f is valid
-    if (!f || !*f)
-    {
-        return 0;
-    }
-
-    // Handle negative conversions for basement floors (b or B)
-    if (f[0] == 'b' || f[0] == 'B')
-    {
-        // Convert the string to long integer ingoring leading B/b
-        char *end = NULL;
-        long i = strtol(f + 1, &end, 10);
-        // Check to make sure floor has been parsed
-        // and is within 1 to 99
-        if (end == f + 1 || i < 1 || i > 99)
-        {
-            return 0;
-        }
-        // Valid floor is passed to pointer and returns successfully
-        *out = -(int)i;
-        return 1;
-    }
-    // Otherwise handle positive floor numbers
-    else
-    {
-        // Convert the string to long integer
-        char *end = NULL;
-        long i = strtol(f, &end, 10);
-        // Check to make sure floor has been parsed
-        // and is within 1 to 999
-        if (end == f || i < 1 || i > 999)
-        {
-            return 0;
-        }
-        // Valid floor is passed to pointer and returns successfully
-        *out = (int)i;
-        return 1;
-    }
-}
-
-static void index_handler(int index, char out[4])
-{
-    // Checks if a floor is negative based on the index
-    if (index < 0)
-    {
-        // If it is negative then the string should
-        // be formatted with a leading B
-        snprintf(out, 4, "B%d", -index);
-    }
-    else 
-    {
-        // Otherwise format as a standard number
-        snprintf(out, 4, "%d", index);
-    }
-}
+#include "shm_sync.h"
+#include "parse_util.h"
 
 int main(int argc, char *argv[])
 {
@@ -104,15 +45,20 @@ int main(int argc, char *argv[])
     }
 
 
-    pthread_mutex_lock(&shm_ptr->mutex);
+    // Recovers the mutex if a previous holder died with it locked
+    shm_lock(shm_ptr);
 
+    // Topics the operation changes, so only interested waiters wake
+    unsigned topics = SHM_MODES;
     if(strcmp(operation, "open") == 0)
     {
         shm_ptr->open_button = 1;
+        topics = SHM_BUTTONS;
     }
     else if(strcmp(operation, "close") == 0)
     {
         shm_ptr->close_button = 1;
+        topics = SHM_BUTTONS;
     }
     else if(strcmp(operation, "stop") == 0)
     {
@@ -168,6 +114,7 @@ int main(int argc, char *argv[])
             strncpy(shm_ptr->destination_floor, dst_floor, sizeof shm_ptr->destination_floor -1);
             shm_ptr->destination_floor[sizeof shm_ptr->destination_floor - 1] = '\0';
         }
+        topics = SHM_MOTION;
 
     }
     else
@@ -181,7 +128,7 @@ int main(int argc, char *argv[])
 
   
      // Notify any waiting processes of changes
-    pthread_cond_broadcast(&shm_ptr->cond);
+    shm_notify(shm_ptr, topics);
     // Unlock mutex
     pthread_mutex_unlock(&shm_ptr->mutex);
     // Unmap shared memory and close file descriptor
@@ -0,0 +1,166 @@
+// Author: Alexandros Sacranie
+// Module: Safety Critical Monitor (journal.c)
+// Project: Distributed Elevator Control System
+
+/* Trip journal
+
+    The journal is a pre-sized file mapped with MAP_SHARED. Writers reserve a
+    slot with an atomic increment, fill it in place and publish it by storing
+    the commit byte last with release ordering, so appends never take a lock
+    or call into the file system; the kernel writes dirty pages back in the
+    background. Concurrent writers commit out of order, so a crash can leave
+    an uncommitted slot between committed ones; readers skip such torn slots
+    rather than stopping at them. The slot and trip id counters live in the
+    mapped header, so a restarted controller resumes after every slot ever
+    reserved and never reuses a trip id.
+*/
+
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "journal.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static journal_header_t* g_header = NULL;
+static journal_record_t* g_records = NULL;
+static size_t g_map_len = 0;
+static uint64_t g_capacity = 0;
+static _Atomic uint64_t g_dropped = 0;
+// Counters used until a journal is open
+static _Atomic uint64_t g_local_next = 0;
+static _Atomic uint32_t g_local_trip = 1;
+// Slot and trip id counters, in the journal header once one is open
+static _Atomic uint64_t* g_next = &g_local_next;
+static _Atomic uint32_t* g_trip = &g_local_trip;
+
+//                  Open and Close                  //
+
+int journal_open(const char* path, uint64_t capacity)
+{
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd == -1)
+    {
+        return -1;
+    }
+    // An existing journal keeps its own capacity
+    journal_header_t existing;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof existing &&
+        pread(fd, &existing, sizeof existing, 0) == (ssize_t)sizeof existing &&
+        memcmp(existing.magic, JOURNAL_MAGIC, sizeof existing.magic) == 0)
+    {
+        if (existing.version != JOURNAL_VERSION || existing.record_size != sizeof(journal_record_t))
+        {
+            close(fd);
+            return -1;
+        }
+        capacity = existing.capacity;
+    }
+
+    // Size the file for the header and every record slot
+    size_t len = sizeof(journal_header_t) + (size_t)capacity * sizeof(journal_record_t);
+    if (ftruncate(fd, (off_t)len) == -1)
+    {
+        close(fd);
+        return -1;
+    }
+    void* p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+    {
+        return -1;
+    }
+
+    g_header = (journal_header_t*)p;
+    g_records = (journal_record_t*)((char*)p + sizeof(journal_header_t));
+    g_map_len = len;
+    g_capacity = capacity;
+
+    // Initialise the header of a new journal
+    if (memcmp(g_header->magic, JOURNAL_MAGIC, sizeof g_header->magic) != 0)
+    {
+        memset(g_header, 0, sizeof *g_header);
+        g_header->version = JOURNAL_VERSION;
+        g_header->record_size = sizeof(journal_record_t);
+        g_header->capacity = capacity;
+        g_header->next_trip = 1;
+        memcpy(g_header->magic, JOURNAL_MAGIC, sizeof g_header->magic);
+    }
+
+    // Trip ids handed out before the journal was opened stay unique
+    if (g_header->next_trip < atomic_load(&g_local_trip))
+    {
+        g_header->next_trip = atomic_load(&g_local_trip);
+    }
+    // Appends and trip ids continue from the counters in the header
+    g_next = (_Atomic uint64_t*)&g_header->next_slot;
+    g_trip = (_Atomic uint32_t*)&g_header->next_trip;
+    return 0;
+}
+
+void journal_close(void)
+{
+    if (g_header)
+    {
+        // Keep allocating trip ids from where the journal left off
+        atomic_store(&g_local_trip, atomic_load(g_trip));
+        g_next = &g_local_next;
+        g_trip = &g_local_trip;
+        munmap(g_header, g_map_len);
+        g_header = NULL;
+        g_records = NULL;
+    }
+}
+
+//                  Appending                  //
+
+uint32_t journal_trip_id(void)
+{
+    return atomic_fetch_add(g_trip, 1u);
+}
+
+void journal_append(uint8_t type, uint32_t trip_id, int src_floor, int dst_floor, const char* car, uint32_t eta_ms)
+{
+    if (!g_records)
+    {
+        return;
+    }
+    // Reserve a slot
+    uint64_t idx = atomic_fetch_add_explicit(g_next, 1u, memory_order_relaxed);
+    if (idx >= g_capacity)
+    {
+        atomic_fetch_add_explicit(&g_dropped, 1u, memory_order_relaxed);
+        return;
+    }
+    // Fill in the record
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    journal_record_t* r = &g_records[idx];
+    r->time_ns = (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+    r->trip_id = trip_id;
+    r->eta_ms = eta_ms;
+    r->src_floor = (int16_t)src_floor;
+    r->dst_floor = (int16_t)dst_floor;
+    r->type = type;
+    memset(r->car, 0, sizeof r->car);
+    if (car)
+    {
+        strncpy(r->car, car, sizeof r->car - 1);
+    }
+    // Publish the record
+    atomic_store_explicit((_Atomic uint8_t*)&r->commit, 1u, memory_order_release);
+}
+
+uint64_t journal_dropped(void)
+{
+    return atomic_load(&g_dropped);
+}
@@ -0,0 +1,63 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stdint.h>
+
+// Journal files start with this magic followed by fixed-size records
+#define JOURNAL_MAGIC "ELEVJRN1"
+#define JOURNAL_VERSION 1u
+// Default number of records a journal file holds (128 MB)
+#define JOURNAL_CAPACITY (4u * 1024u * 1024u)
+
+// Trip events recorded in the journal
+enum
+{
+    JOURNAL_CALL = 1,  // Call received from a call pad
+    JOURNAL_ASSIGN,    // Car assigned to the trip (eta_ms set)
+    JOURNAL_REJECT,    // No car could take the trip
+    JOURNAL_PICKUP,    // Car opened at the trip's source floor
+    JOURNAL_DROPOFF,   // Car opened at the trip's destination floor
+    JOURNAL_FORWARD    // Call handed to a peer zone (car and eta_ms from the peer)
+};
+
+// File header, one per journal
+typedef struct {
+  char magic[8];          // JOURNAL_MAGIC
+  uint32_t version;       // JOURNAL_VERSION
+  uint32_t record_size;   // sizeof(journal_record_t)
+  uint64_t capacity;      // Number of record slots in the file
+  uint64_t next_slot;     // Slots reserved so far; slots below it may be torn
+  uint32_t next_trip;     // Next trip id to allocate
+  uint8_t reserved[28];   // Pads the header to 64 bytes
+} journal_header_t;
+
+// Fixed-size trip record (32 bytes)
+typedef struct {
+  uint64_t time_ns;       // Wall clock time of the event in ns since the epoch
+  uint32_t trip_id;       // Trip the event belongs to
+  uint32_t eta_ms;        // Estimated arrival for JOURNAL_ASSIGN, otherwise 0
+  int16_t src_floor;      // Source floor of the trip
+  int16_t dst_floor;      // Destination floor of the trip
+  uint8_t type;           // One of the JOURNAL_ event types
+  uint8_t commit;         // 1 once the record is complete, 0 for free or torn slots
+  char car[10];           // Car name, truncated (empty when no car)
+} journal_record_t;
+
+// Map a journal file for appending, creating it with the given capacity.
+// Returns 0 on success and -1 on error.
+int journal_open(const char* path, uint64_t capacity);
+
+// Unmap the journal
+void journal_close(void);
+
+// Allocate a trip id (valid whether or not a journal is open)
+uint32_t journal_trip_id(void);
+
+// Append an event; lock-free and never blocks on file I/O. Events are
+// dropped when no journal is open or the file is full.
+void journal_append(uint8_t type, uint32_t trip_id, int src_floor, int dst_floor, const char* car, uint32_t eta_ms);
+
+// Number of events dropped because the journal was full
+uint64_t journal_dropped(void);
+
+#endif // JOURNAL_H
@@ -0,0 +1,431 @@
+// Author: Alexandros Sacranie
+// Module: Safety Critical Monitor (log.c)
+// Project: Distributed Elevator Control System
+
+/* Non-blocking logging
+
+    A log call on a control loop must not wait on a terminal or a pipe.
+    Each thread appends binary records (level, time, format address and the
+    raw arguments, with strings copied) to its own single-producer ring, so
+    a call is a handful of stores and never takes a lock. A flusher thread
+    drains every ring every few milliseconds, merges the records by time,
+    formats them and writes them out. A full ring drops records and the
+    flusher reports how many, rather than stalling the caller.
+*/
+
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "log.h"
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// One log call as captured on the hot path
+typedef struct {
+  struct timespec time;                 // CLOCK_REALTIME when logged
+  const char* fmt;                      // Format literal, formatted by the flusher
+  log_level_t level;
+  int n_args;
+  log_arg_t args[LOG_MAX_ARGS];         // String arguments point into text[]
+  char text[LOG_TEXT_BYTES];            // Copies of the string arguments
+} log_record_t;
+
+// Records of one thread; the thread appends, the flusher drains
+typedef struct log_ring {
+  _Alignas(64) _Atomic uint32_t head;   // Records appended
+  _Alignas(64) _Atomic uint32_t tail;   // Records drained
+  _Atomic uint32_t dropped;             // Records lost to a full ring
+  _Atomic int closed;                   // The thread has exited
+  struct log_ring* next;                // Registry of rings
+  log_record_t records[LOG_RING_RECORDS];
+} log_ring_t;
+
+log_level_t g_log_min_level = LOG_LEVEL_INFO;
+
+static int g_stamp = 0;
+// Every thread's ring. Threads push onto the front under g_rings_mx; only
+// the flusher walks the list and unlinks, so it formats without the lock.
+static pthread_mutex_t g_rings_mx = PTHREAD_MUTEX_INITIALIZER;
+static _Atomic(log_ring_t*) g_rings = NULL;
+static pthread_key_t g_ring_key;
+static pthread_once_t g_key_once = PTHREAD_ONCE_INIT;
+static _Thread_local log_ring_t* t_ring = NULL;
+// Flusher state
+static pthread_mutex_t g_flush_mx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_flush_cv;
+static pthread_t g_flusher;
+static int g_running = 0;
+static int g_stop = 0;
+
+//                  Rings                  //
+
+static void ring_release(void* arg)
+{
+    // The flusher frees the ring once it has drained it
+    atomic_store_explicit(&((log_ring_t*)arg)->closed, 1, memory_order_release);
+}
+
+static void make_key(void)
+{
+    pthread_key_create(&g_ring_key, ring_release);
+}
+
+static log_ring_t* thread_ring(void)
+{
+    if (t_ring)
+    {
+        return t_ring;
+    }
+    // First record of this thread: allocate and register its ring
+    log_ring_t* r = calloc(1, sizeof *r);
+    if (!r)
+    {
+        return NULL;
+    }
+    pthread_once(&g_key_once, make_key);
+    pthread_setspecific(g_ring_key, r);
+    pthread_mutex_lock(&g_rings_mx);
+    r->next = atomic_load_explicit(&g_rings, memory_order_relaxed);
+    atomic_store_explicit(&g_rings, r, memory_order_release);
+    pthread_mutex_unlock(&g_rings_mx);
+    t_ring = r;
+    return r;
+}
+
+void log_write(log_level_t level, const char* fmt, const log_arg_t* args, int n_args)
+{
+    log_ring_t* r = thread_ring();
+    if (!r)
+    {
+        return;
+    }
+    uint32_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+    if (head - tail >= LOG_RING_RECORDS)
+    {
+        atomic_fetch_add_explicit(&r->dropped, 1u, memory_order_relaxed);
+        return;
+    }
+    log_record_t* rec = &r->records[head % LOG_RING_RECORDS];
+    clock_gettime(CLOCK_REALTIME, &rec->time);
+    rec->fmt = fmt;
+    rec->level = level;
+    rec->n_args = n_args < LOG_MAX_ARGS ? n_args : LOG_MAX_ARGS;
+    // Copy the arguments, and the strings they point to since those may
+    // change before the flusher gets to them
+    size_t used = 0;
+    for (int i = 0; i < rec->n_args; ++i)
+    {
+        rec->args[i] = args[i];
+        if (args[i].type == LOG_ARG_STRING)
+        {
+            const char* s = args[i].v.s ? args[i].v.s : "(null)";
+            if (used >= LOG_TEXT_BYTES)
+            {
+                rec->args[i].v.s = "";
+                continue;
+            }
+            // Cut the string to what is left of text[], keeping its terminator
+            size_t len = strnlen(s, LOG_TEXT_BYTES - 1 - used);
+            memcpy(rec->text + used, s, len);
+            rec->text[used + len] = '\0';
+            rec->args[i].v.s = rec->text + used;
+            used += len + 1;
+        }
+    }
+    // Publish the record after its contents
+    atomic_store_explicit(&r->head, head + 1u, memory_order_release);
+}
+
+//                  Formatting                  //
+
+static size_t format_arg(char* out, size_t cap, const char* spec, size_t spec_len, char conv, const log_arg_t* a)
+{
+    // Rebuild the conversion with the length modifier of the captured type
+    char f[32];
+    size_t n = 0;
+    for (size_t i = 0; i < spec_len && n < sizeof f - 4; ++i)
+    {
+        // Drop the caller's length modifiers
+        if (strchr("hlLqjzt", spec[i]) == NULL)
+        {
+            f[n++] = spec[i];
+        }
+    }
+    int w = -1;
+    if (memchr(spec, '*', spec_len))
+    {
+        // Widths and precisions taken from arguments are not captured
+        w = snprintf(out, cap, "?");
+    }
+    else if (strchr("diouxXc", conv) && (a->type == LOG_ARG_INT || a->type == LOG_ARG_UNSIGNED))
+    {
+        if (conv == 'c')
+        {
+            f[n++] = conv;
+            f[n] = '\0';
+            w = snprintf(out, cap, f, (int)a->v.i);
+        }
+        else
+        {
+            f[n++] = 'l';
+            f[n++] = 'l';
+            f[n++] = conv;
+            f[n] = '\0';
+            w = a->type == LOG_ARG_INT ? snprintf(out, cap, f, a->v.i) : snprintf(out, cap, f, a->v.u);
+        }
+    }
+    else if (strchr("eEfFgGaA", conv) && a->type == LOG_ARG_DOUBLE)
+    {
+        f[n++] = conv;
+        f[n] = '\0';
+        w = snprintf(out, cap, f, a->v.d);
+    }
+    else if (conv == 's' && a->type == LOG_ARG_STRING)
+    {
+        f[n++] = conv;
+        f[n] = '\0';
+        w = snprintf(out, cap, f, a->v.s);
+    }
+    else if (conv == 'p')
+    {
+        w = snprintf(out, cap, "%p", a->v.p);
+    }
+    else
+    {
+        // Argument does not match the conversion
+        w = snprintf(out, cap, "?");
+    }
+    if (w < 0)
+    {
+        return 0;
+    }
+    return (size_t)w < cap ? (size_t)w : cap - 1;
+}
+
+static size_t format_record(const log_record_t* rec, char* out, size_t cap)
+{
+    size_t len = 0;
+    int next = 0;
+    for (const char* p = rec->fmt; *p && len < cap - 1; ++p)
+    {
+        if (*p != '%')
+        {
+            out[len++] = *p;
+            continue;
+        }
+        if (p[1] == '%')
+        {
+            out[len++] = '%';
+            p++;
+            continue;
+        }
+        // Find the conversion character ending this specification
+        const char* spec = p;
+        const char* end = p + 1;
+        while (*end && strchr("diouxXeEfFgGaAcsp", *end) == NULL)
+        {
+            end++;
+        }
+        if (!*end)
+        {
+            break;
+        }
+        if (next < rec->n_args)
+        {
+            len += format_arg(out + len, cap - len, spec, (size_t)(end - spec), *end, &rec->args[next++]);
+        }
+        p = end;
+    }
+    out[len] = '\0';
+    return len;
+}
+
+static void write_record(const log_record_t* rec)
+{
+    static const char* const names[] = {"DEBUG", "INFO", "WARN", "ERROR"};
+    char line[512];
+    size_t len = 0;
+    if (g_stamp)
+    {
+        struct tm tm;
+        localtime_r(&rec->time.tv_sec, &tm);
+        len = strftime(line, sizeof line, "%H:%M:%S", &tm);
+        len += (size_t)snprintf(line + len, sizeof line - len, ".%03ld %-5s ",
+                                rec->time.tv_nsec / 1000000L, names[rec->level]);
+    }
+    len += format_record(rec, line + len, sizeof line - len - 1);
+    line[len++] = '\n';
+    fwrite(line, 1, len, rec->level >= LOG_LEVEL_ERROR ? stderr : stdout);
+}
+
+//                  Flusher                  //
+
+static int time_before(const struct timespec* a, const struct timespec* b)
+{
+    return a->tv_sec < b->tv_sec || (a->tv_sec == b->tv_sec && a->tv_nsec < b->tv_nsec);
+}
+
+static void drain(void)
+{
+    // Rings registered after this load wait for the next pass
+    log_ring_t* first = atomic_load_explicit(&g_rings, memory_order_acquire);
+    // Write records oldest first across all threads
+    for (;;)
+    {
+        log_ring_t* oldest = NULL;
+        const log_record_t* rec = NULL;
+        for (log_ring_t* r = first; r; r = r->next)
+        {
+            uint32_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+            if (tail == atomic_load_explicit(&r->head, memory_order_acquire))
+            {
+                continue;
+            }
+            const log_record_t* candidate = &r->records[tail % LOG_RING_RECORDS];
+            if (!rec || time_before(&candidate->time, &rec->time))
+            {
+                oldest = r;
+                rec = candidate;
+            }
+        }
+        if (!oldest)
+        {
+            break;
+        }
+        write_record(rec);
+        // Hand the slot back only once it has been formatted
+        atomic_fetch_add_explicit(&oldest->tail, 1u, memory_order_release);
+    }
+
+    // Count drops and unlink the drained rings of threads that have exited
+    unsigned dropped = 0;
+    log_ring_t* dead = NULL;
+    pthread_mutex_lock(&g_rings_mx);
+    for (log_ring_t* r = atomic_load_explicit(&g_rings, memory_order_relaxed), *prev = NULL, *next; r; r = next)
+    {
+        next = r->next;
+        dropped += atomic_exchange_explicit(&r->dropped, 0u, memory_order_relaxed);
+        if (atomic_load_explicit(&r->closed, memory_order_acquire) &&
+            atomic_load_explicit(&r->tail, memory_order_relaxed) == atomic_load_explicit(&r->head, memory_order_acquire))
+        {
+            if (prev)
+            {
+                prev->next = next;
+            }
+            else
+            {
+                atomic_store_explicit(&g_rings, next, memory_order_relaxed);
+            }
+            r->next = dead;
+            dead = r;
+            continue;
+        }
+        prev = r;
+    }
+    pthread_mutex_unlock(&g_rings_mx);
+    while (dead)
+    {
+        log_ring_t* next = dead->next;
+        free(dead);
+        dead = next;
+    }
+    if (dropped)
+    {
+        fprintf(stderr, "log: %u records dropped\n", dropped);
+    }
+    fflush(stdout);
+    fflush(stderr);
+}
+
+static void* flusher_thread(void* arg)
+{
+    (void)arg;
+    pthread_mutex_lock(&g_flush_mx);
+    while (!g_stop)
+    {
+        // Sleep a flush period, or until shutdown
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        ts.tv_nsec += LOG_FLUSH_MS * 1000000L;
+        if (ts.tv_nsec >= 1000000000L)
+        {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&g_flush_cv, &g_flush_mx, &ts);
+        pthread_mutex_unlock(&g_flush_mx);
+        drain();
+        pthread_mutex_lock(&g_flush_mx);
+    }
+    pthread_mutex_unlock(&g_flush_mx);
+    // Write whatever was logged up to shutdown
+    drain();
+    return NULL;
+}
+
+//                  Setup                  //
+
+int log_level_parse(const char* name, log_level_t* out)
+{
+    static const char* const names[] = {"debug", "info", "warn", "error"};
+    for (int i = 0; i < 4; ++i)
+    {
+        if (strcmp(name, names[i]) == 0)
+        {
+            *out = (log_level_t)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+int log_init(log_level_t min_level, int stamp)
+{
+    g_log_min_level = min_level;
+    g_stamp = stamp;
+    if (g_running)
+    {
+        return 0;
+    }
+    // The flusher's period is measured on the monotonic clock
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&g_flush_cv, &attr);
+    pthread_condattr_destroy(&attr);
+    // Signals belong to the program's own threads, never the flusher
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    int err = pthread_create(&g_flusher, NULL, flusher_thread, NULL);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if (err != 0)
+    {
+        return -1;
+    }
+    g_running = 1;
+    atexit(log_shutdown);
+    return 0;
+}
+
+void log_shutdown(void)
+{
+    if (!g_running)
+    {
+        return;
+    }
+    g_running = 0;
+    pthread_mutex_lock(&g_flush_mx);
+    g_stop = 1;
+    pthread_cond_signal(&g_flush_cv);
+    pthread_mutex_unlock(&g_flush_mx);
+    pthread_join(g_flusher, NULL);
+}
@@ -0,0 +1,143 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <stdio.h>
+
+// Severity of a log record; records below the configured level are skipped
+typedef enum
+{
+    LOG_LEVEL_DEBUG,
+    LOG_LEVEL_INFO,
+    LOG_LEVEL_WARN,
+    LOG_LEVEL_ERROR    // Printed to stderr, the rest to stdout
+} log_level_t;
+
+// Most arguments one record carries after the format
+#define LOG_MAX_ARGS 6
+// Bytes of string arguments copied into one record (longer ones are cut)
+#define LOG_TEXT_BYTES 64
+// Records each thread's ring holds (a power of two)
+#define LOG_RING_RECORDS 256
+// How often the flusher drains the rings
+#define LOG_FLUSH_MS 10
+
+// How an argument was captured
+typedef enum
+{
+    LOG_ARG_INT,
+    LOG_ARG_UNSIGNED,
+    LOG_ARG_DOUBLE,
+    LOG_ARG_STRING,    // Copied into the record, formatted from the copy
+    LOG_ARG_POINTER
+} log_arg_type_t;
+
+// One captured argument
+typedef struct {
+  log_arg_type_t type;
+  union {
+    long long i;
+    unsigned long long u;
+    double d;
+    const char* s;
+    const void* p;
+  } v;
+} log_arg_t;
+
+static inline log_arg_t log_arg_int(long long v)
+{
+    log_arg_t a = {LOG_ARG_INT, {.i = v}};
+    return a;
+}
+
+static inline log_arg_t log_arg_unsigned(unsigned long long v)
+{
+    log_arg_t a = {LOG_ARG_UNSIGNED, {.u = v}};
+    return a;
+}
+
+static inline log_arg_t log_arg_double(double v)
+{
+    log_arg_t a = {LOG_ARG_DOUBLE, {.d = v}};
+    return a;
+}
+
+static inline log_arg_t log_arg_string(const char* v)
+{
+    log_arg_t a = {LOG_ARG_STRING, {.s = v}};
+    return a;
+}
+
+static inline log_arg_t log_arg_pointer(const void* v)
+{
+    log_arg_t a = {LOG_ARG_POINTER, {.p = v}};
+    return a;
+}
+
+// Capture an argument by its type; character arrays decay to strings
+#define LOG_ARG(x) _Generic((x),                                              \
+    char*: log_arg_string, const char*: log_arg_string,                      \
+    float: log_arg_double, double: log_arg_double,                           \
+    unsigned int: log_arg_unsigned, unsigned long: log_arg_unsigned,         \
+    unsigned long long: log_arg_unsigned,                                    \
+    void*: log_arg_pointer, const void*: log_arg_pointer,                    \
+    default: log_arg_int)(x)
+
+// Argument counting and mapping behind LOG(); the format counts as one
+#define LOG_COUNT(...) LOG_COUNT_(__VA_ARGS__, 7, 6, 5, 4, 3, 2, 1, 0)
+#define LOG_COUNT_(_1, _2, _3, _4, _5, _6, _7, N, ...) N
+#define LOG_CAT(a, b) LOG_CAT_(a, b)
+#define LOG_CAT_(a, b) a##b
+#define LOG_FIRST(f, ...) f
+#define LOG_MAP_1(f)
+#define LOG_MAP_2(f, a) , LOG_ARG(a)
+#define LOG_MAP_3(f, a, b) , LOG_ARG(a), LOG_ARG(b)
+#define LOG_MAP_4(f, a, b, c) , LOG_ARG(a), LOG_ARG(b), LOG_ARG(c)
+#define LOG_MAP_5(f, a, b, c, d) , LOG_ARG(a), LOG_ARG(b), LOG_ARG(c), LOG_ARG(d)
+#define LOG_MAP_6(f, a, b, c, d, e) , LOG_ARG(a), LOG_ARG(b), LOG_ARG(c), LOG_ARG(d), LOG_ARG(e)
+#define LOG_MAP_7(f, a, b, c, d, e, g) , LOG_ARG(a), LOG_ARG(b), LOG_ARG(c), LOG_ARG(d), LOG_ARG(e), LOG_ARG(g)
+
+// Level records are kept from; set by log_init
+extern log_level_t g_log_min_level;
+
+// Record a printf-style message. The format must be a string literal: only
+// its address and the arguments are stored, and the flusher thread formats
+// them later. printf checks the format at compile time and is never called.
+#define LOG(level, ...)                                                       \
+    do                                                                        \
+    {                                                                         \
+        if ((level) >= g_log_min_level)                                       \
+        {                                                                     \
+            const log_arg_t log_args_[] = {                                   \
+                log_arg_int(0) LOG_CAT(LOG_MAP_, LOG_COUNT(__VA_ARGS__))(__VA_ARGS__) \
+            };                                                                \
+            log_write((level), LOG_FIRST(__VA_ARGS__, 0), log_args_ + 1,      \
+                      LOG_COUNT(__VA_ARGS__) - 1);                            \
+        }                                                                     \
+        if (0)                                                                \
+        {                                                                     \
+            printf(__VA_ARGS__);                                              \
+        }                                                                     \
+    } while (0)
+
+#define LOG_DEBUG(...) LOG(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#define LOG_INFO(...)  LOG(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_WARN(...)  LOG(LOG_LEVEL_WARN, __VA_ARGS__)
+#define LOG_ERROR(...) LOG(LOG_LEVEL_ERROR, __VA_ARGS__)
+
+// Start the flusher thread. Records below min_level are dropped at the
+// call site; stamp prefixes each line with the wall clock time and level.
+// Returns 0 on success and -1 on error.
+int log_init(log_level_t min_level, int stamp);
+
+// Parse "debug", "info", "warn" or "error"; returns 0 on success and -1
+// if the name is unknown
+int log_level_parse(const char* name, log_level_t* out);
+
+// Append a record to the calling thread's ring. Never blocks: a full ring
+// drops the record and counts it. Use LOG() rather than calling this.
+void log_write(log_level_t level, const char* fmt, const log_arg_t* args, int n_args);
+
+// Drain every ring and stop the flusher; also run at normal exit
+void log_shutdown(void);
+
+#endif // LOG_H
@@ -0,0 +1,174 @@
+// Author: Alexandros Sacranie
+// Module: Safety Critical Monitor (parse_util.c)
+// Project: Distributed Elevator Control System
+
+/* Floor names
+
+    Floors are named 1 to 999 above ground and B1 to B99 below, and carried
+    as those strings in frames and in the shared memory. The conversions
+    are built optimised into libelevator.a and linked by every program.
+
+    They run on every frame, move and safety check, so both directions
+    avoid the C library. Parsing reads the one to three digits directly;
+    only tokens strtol would treat specially (whitespace, a sign, leading
+    zeros past three digits) take the strtol path, which keeps the
+    results identical. Formatting copies the name from a table holding
+    every floor from B99 to 999, built by the compiler; numbers outside it
+    have no name and format as the empty string.
+*/
+
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "parse_util.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//                  Parsing                  //
+
+// Parse a decimal floor the way strtol would, for tokens the fast path
+// leaves alone. Returns 1 if the value is within 1 to max.
+static int parse_slow(const char *p, long max, long *out)
+{
+    // Convert the string to long integer
+    char *end = NULL;
+    long i = strtol(p, &end, 10);
+    // Check to make sure floor has been parsed and is within range
+    if (end == p || i < 1 || i > max)
+    {
+        return 0;
+    }
+    *out = i;
+    return 1;
+}
+
+// Parse one to three leading digits; anything past them that is not a
+// digit ends the number, as it would for strtol. Returns 1 if the value
+// is within 1 to max.
+static int parse_digits(const char *p, long max, long *out)
+{
+    // Digits map to 0..9; every other byte wraps above 9
+    unsigned d0 = (unsigned char)p[0] - '0';
+    if (d0 > 9)
+    {
+        // Whitespace and signs are strtol's business
+        return parse_slow(p, max, out);
+    }
+    unsigned v = d0;
+    unsigned d1 = (unsigned char)p[1] - '0';
+    if (d1 <= 9)
+    {
+        v = v * 10 + d1;
+        unsigned d2 = (unsigned char)p[2] - '0';
+        if (d2 <= 9)
+        {
+            v = v * 10 + d2;
+            // A fourth digit is out of range unless zeros lead
+            if ((unsigned)((unsigned char)p[3] - '0') <= 9)
+            {
+                return parse_slow(p, max, out);
+            }
+        }
+    }
+    // One unsigned comparison rejects both 0 and values above max
+    if (v - 1 >= (unsigned)max)
+    {
+        return 0;
+    }
+    *out = (long)v;
+    return 1;
+}
+
+int floor_num_handler(const char *f, int *out)
+{
+    // Check to ensure that f is valid
+    if (!f || !*f)
+    {
+        return 0;
+    }
+
+    long i;
+    // Handle negative conversions for basement floors (b or B);
+    // setting bit 5 folds 'B' onto 'b'
+    if ((f[0] | 0x20) == 'b')
+    {
+        // Floor must be parsed and within 1 to 99
+        if (!parse_digits(f + 1, 99, &i))
+        {
+            return 0;
+        }
+        // Valid floor is passed to pointer and returns successfully
+        *out = -(int)i;
+        return 1;
+    }
+    // Otherwise handle positive floor numbers within 1 to 999
+    if (!parse_digits(f, 999, &i))
+    {
+        return 0;
+    }
+    // Valid floor is passed to pointer and returns successfully
+    *out = (int)i;
+    return 1;
+}
+
+//                  Formatting                  //
+
+// Lowest and highest floor held in the name table
+#define FLOOR_TABLE_LOW -99
+#define FLOOR_TABLE_HIGH 999
+
+// Name of floor n >= 0, padded with nul bytes to four characters
+#define FLOOR_NAME(n) {                                                       \
+    (char)((n) >= 100 ? '0' + (n) / 100 : (n) >= 10 ? '0' + (n) / 10 : '0' + (n)), \
+    (char)((n) >= 100 ? '0' + (n) / 10 % 10 : (n) >= 10 ? '0' + (n) % 10 : 0),     \
+    (char)((n) >= 100 ? '0' + (n) % 10 : 0), 0}
+
+// Name of basement floor Bn, 1 <= n <= 99
+#define BASEMENT_NAME(n) {                                                    \
+    'B', (char)((n) >= 10 ? '0' + (n) / 10 : '0' + (n)),                      \
+    (char)((n) >= 10 ? '0' + (n) % 10 : 0), 0}
+
+// Runs of consecutive floors counting up from n
+#define FLOORS_10(n) FLOOR_NAME((n)), FLOOR_NAME((n) + 1), FLOOR_NAME((n) + 2), \
+    FLOOR_NAME((n) + 3), FLOOR_NAME((n) + 4), FLOOR_NAME((n) + 5),            \
+    FLOOR_NAME((n) + 6), FLOOR_NAME((n) + 7), FLOOR_NAME((n) + 8), FLOOR_NAME((n) + 9)
+#define FLOORS_100(n) FLOORS_10((n)), FLOORS_10((n) + 10), FLOORS_10((n) + 20), \
+    FLOORS_10((n) + 30), FLOORS_10((n) + 40), FLOORS_10((n) + 50),            \
+    FLOORS_10((n) + 60), FLOORS_10((n) + 70), FLOORS_10((n) + 80), FLOORS_10((n) + 90)
+
+// Runs of basement floors counting down from Bn
+#define BASEMENTS_10(n) BASEMENT_NAME((n)), BASEMENT_NAME((n) - 1),           \
+    BASEMENT_NAME((n) - 2), BASEMENT_NAME((n) - 3), BASEMENT_NAME((n) - 4),   \
+    BASEMENT_NAME((n) - 5), BASEMENT_NAME((n) - 6), BASEMENT_NAME((n) - 7),   \
+    BASEMENT_NAME((n) - 8), BASEMENT_NAME((n) - 9)
+
+// Names of floors B99 to 999 (and 0, which index_handler has always
+// formatted as "0"), indexed by floor - FLOOR_TABLE_LOW
+static const char g_floor_names[FLOOR_TABLE_HIGH - FLOOR_TABLE_LOW + 1][4] = {
+    BASEMENTS_10(99), BASEMENTS_10(89), BASEMENTS_10(79), BASEMENTS_10(69),
+    BASEMENTS_10(59), BASEMENTS_10(49), BASEMENTS_10(39), BASEMENTS_10(29),
+    BASEMENTS_10(19),
+    BASEMENT_NAME(9), BASEMENT_NAME(8), BASEMENT_NAME(7), BASEMENT_NAME(6),
+    BASEMENT_NAME(5), BASEMENT_NAME(4), BASEMENT_NAME(3), BASEMENT_NAME(2),
+    BASEMENT_NAME(1),
+    FLOORS_100(0), FLOORS_100(100), FLOORS_100(200), FLOORS_100(300),
+    FLOORS_100(400), FLOORS_100(500), FLOORS_100(600), FLOORS_100(700),
+    FLOORS_100(800), FLOORS_100(900)
+};
+
+void index_handler(int index, char out[4])
+{
+    // Floors in the table are one four-byte copy
+    unsigned slot = (unsigned)index - (unsigned)FLOOR_TABLE_LOW;
+    if (slot <= (unsigned)(FLOOR_TABLE_HIGH - FLOOR_TABLE_LOW))
+    {
+        memcpy(out, g_floor_names[slot], 4);
+        return;
+    }
+    // No floor name fits outside the table, so give the empty name, which
+    // floor_num_handler rejects, rather than a truncated one
+    memset(out, 0, 4);
+}
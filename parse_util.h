@@ -0,0 +1,12 @@
+#ifndef PARSE_UTIL_H
+#define PARSE_UTIL_H
+
+// Parse a floor name ("1" to "999", "B1" to "B99", b or B) into a floor
+// number, negative below ground. Returns 1 on success and 0 if invalid.
+int floor_num_handler(const char *f, int *out);
+
+// Format a floor number (B99 to 999) as its name; numbers outside that
+// range give the empty string
+void index_handler(int index, char out[4]);
+
+#endif // PARSE_UTIL_H
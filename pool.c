@@ -0,0 +1,161 @@
+// Author: Alexandros Sacranie
+// Module: Safety Critical Monitor (pool.c)
+// Project: Distributed Elevator Control System
+
+/* Connection worker pool
+
+    Call connections exchange one frame each way, so spawning a thread per
+    connection costs more than the work itself. Acceptors push sockets onto
+    a fixed ring and a fixed set of workers pop and handle them. The ring is
+    bounded: when every slot is taken the acceptor waits, leaving further
+    connections in the kernel's listen backlog. Each socket carries the time
+    it was submitted, so the handler can tell how stale the connection is
+    and shed it rather than answer a caller who has waited too long.
+*/
+
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "pool.h"
+#include "time_util.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+
+static pthread_mutex_t g_mtx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_not_empty = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t g_not_full = PTHREAD_COND_INITIALIZER;
+static pool_handler_fn g_handler = NULL;
+// Queued socket and when it was submitted (monotonic ms)
+typedef struct
+{
+    int socket_fd;
+    long since_ms;
+} pool_entry_t;
+// Ring of queued sockets
+static pool_entry_t* g_ring = NULL;
+static int g_capacity = 0;
+static int g_head = 0;
+static int g_len = 0;
+// Counters reported by pool_stats
+static int g_workers = 0;
+static int g_busy = 0;
+static int g_peak = 0;
+static long g_wait_peak_ms = 0;
+static uint64_t g_handled = 0;
+static uint64_t g_stalls = 0;
+
+//                  Workers                  //
+
+static void *pool_worker(void *arg)
+{
+    (void)arg;
+    for (;;)
+    {
+        pthread_mutex_lock(&g_mtx);
+        // Wait for a queued connection
+        while (g_len == 0)
+        {
+            pthread_cond_wait(&g_not_empty, &g_mtx);
+        }
+        pool_entry_t entry = g_ring[g_head];
+        g_head = (g_head + 1) % g_capacity;
+        g_len--;
+        g_busy++;
+        g_handled++;
+        pthread_cond_signal(&g_not_full);
+        pthread_mutex_unlock(&g_mtx);
+
+        // Time spent queued, including any wait for a free slot
+        long queued_ms = now_ms() - entry.since_ms;
+
+        // Handle the connection outside the lock
+        g_handler(entry.socket_fd, queued_ms);
+
+        pthread_mutex_lock(&g_mtx);
+        g_busy--;
+        if (queued_ms > g_wait_peak_ms)
+        {
+            g_wait_peak_ms = queued_ms;
+        }
+        pthread_mutex_unlock(&g_mtx);
+    }
+    return NULL;
+}
+
+int pool_start(int workers, int depth, pool_handler_fn handler)
+{
+    if (workers < 1 || depth < 1 || !handler)
+    {
+        return -1;
+    }
+    g_ring = (pool_entry_t*)malloc((size_t)depth * sizeof *g_ring);
+    if (!g_ring)
+    {
+        return -1;
+    }
+    g_capacity = depth;
+    g_handler = handler;
+
+    // Workers need far less than the default thread stack
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, POOL_STACK_SIZE);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    for (int i = 0; i < workers; ++i)
+    {
+        pthread_t tid;
+        if (pthread_create(&tid, &attr, pool_worker, NULL) != 0)
+        {
+            pthread_attr_destroy(&attr);
+            return -1;
+        }
+        pthread_mutex_lock(&g_mtx);
+        g_workers++;
+        pthread_mutex_unlock(&g_mtx);
+    }
+    pthread_attr_destroy(&attr);
+    return 0;
+}
+
+//                  Submission and Metrics                  //
+
+void pool_submit(int socket_fd)
+{
+    // The connection's wait starts now, before any stall on a full queue
+    long since_ms = now_ms();
+    pthread_mutex_lock(&g_mtx);
+    // Hold the acceptor back while every slot is taken
+    if (g_len == g_capacity)
+    {
+        g_stalls++;
+    }
+    while (g_len == g_capacity)
+    {
+        pthread_cond_wait(&g_not_full, &g_mtx);
+    }
+    g_ring[(g_head + g_len) % g_capacity].socket_fd = socket_fd;
+    g_ring[(g_head + g_len) % g_capacity].since_ms = since_ms;
+    g_len++;
+    if (g_len > g_peak)
+    {
+        g_peak = g_len;
+    }
+    pthread_cond_signal(&g_not_empty);
+    pthread_mutex_unlock(&g_mtx);
+}
+
+void pool_stats(pool_stats_t* out)
+{
+    pthread_mutex_lock(&g_mtx);
+    out->workers = g_workers;
+    out->busy = g_busy;
+    out->queued = g_len;
+    out->capacity = g_capacity;
+    out->peak = g_peak;
+    out->wait_peak_ms = g_wait_peak_ms;
+    out->handled = g_handled;
+    out->stalls = g_stalls;
+    pthread_mutex_unlock(&g_mtx);
+}
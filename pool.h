@@ -0,0 +1,39 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stdint.h>
+
+// Defaults for the connection worker pool
+#define POOL_DEFAULT_WORKERS 4
+#define POOL_DEFAULT_DEPTH 256
+// Stack reserved per worker; handlers only parse and answer one frame
+#define POOL_STACK_SIZE (256u * 1024u)
+
+// Handles one accepted connection and owns the socket from then on;
+// queued_ms is how long the connection waited for a worker
+typedef void (*pool_handler_fn)(int socket_fd, long queued_ms);
+
+// Pool counters for the STATS frame
+typedef struct {
+  int workers;            // Worker threads
+  int busy;               // Workers handling a connection
+  int queued;             // Connections waiting for a worker
+  int capacity;           // Queue depth
+  int peak;               // Most connections ever waiting at once
+  long wait_peak_ms;      // Longest a connection waited for a worker
+  uint64_t handled;       // Connections handed to the handler
+  uint64_t stalls;        // Submissions that waited for a free queue slot
+} pool_stats_t;
+
+// Start a fixed number of workers draining a bounded queue of sockets.
+// Returns 0 on success and -1 on error.
+int pool_start(int workers, int depth, pool_handler_fn handler);
+
+// Queue an accepted socket, waiting while the queue is full so excess
+// connections back up in the listen backlog instead of in memory
+void pool_submit(int socket_fd);
+
+// Copy the current counters
+void pool_stats(pool_stats_t* out);
+
+#endif // POOL_H
@@ -0,0 +1,584 @@
+// Author: Alexandros Sacranie
+// Module: Safety Critical Monitor (replay.c)
+// Project: Distributed Elevator Control System
+
+/* Offline dispatch replay
+
+    Feeds recorded calls back through the controller's dispatch logic against
+    simulated cars and reports passenger wait and travel times. Time is
+    simulated, so a day of traffic replays in well under a second and two
+    runs over the same trace always produce the same numbers. The demand
+    forecast decays over simulated time too, so origin shares, and the
+    dispatch costs built on them, match what the controller computed live.
+
+    Traces are either a trip journal written with controller -j (only CALL
+    records are used) or a text file of "<unix_ms> <src> <dst>" lines.
+*/
+
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "dispatch.h"
+#include "journal.h"
+#include "traffic.h"
+#include "parse_util.h"
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+//                  Global Variables and Structures                //
+
+// Structure to hold one replayed call and what happened to it
+typedef struct
+{
+    long at_ms;              // Call time relative to the first call
+    time_t wall;             // Wall clock time of the call (traffic slot)
+    int src_floor, dst_floor;
+    int car;                 // Car index assigned (-1 if rejected)
+    long eta_ms;             // Arrival estimate given to the caller
+    long pickup_ms;          // Time the car opened at the source (-1 until then)
+    long dropoff_ms;         // Time the car opened at the destination (-1 until then)
+} replay_call_t;
+
+// Phases of a simulated car
+enum
+{
+    SIM_IDLE,
+    SIM_BETWEEN,
+    SIM_OPENING,
+    SIM_OPEN,
+    SIM_CLOSING
+};
+
+// Structure to hold the physical state of a simulated car
+typedef struct
+{
+    int floor;               // Floor the car is at or last left
+    int phase;               // One of the SIM_ phases
+    long until_ms;           // End of the current phase (LONG_MAX while idle)
+} sim_car_t;
+
+static replay_call_t* g_calls = NULL;
+static size_t g_n_calls = 0;
+
+static CarID g_cars[MAX_CARS];
+static sim_car_t g_sim[MAX_CARS];
+static int g_n_cars = 0;
+
+// Simulated clock in ms since the first call
+static long g_now_ms = 0;
+
+// Simulated car delay per floor and per door state, as given to car
+static long g_delay_ms = 1000;
+
+// Dispatch options mirroring the controller's -b and -d
+static long g_batch_window_ms = 0;
+static int g_dd_span = -1;
+
+//                  Trace Loading                 //
+
+static int add_call(uint64_t unix_ms, int src_floor, int dst_floor)
+{
+    static size_t capacity = 0;
+    // Grow the call array geometrically
+    if (g_n_calls == capacity)
+    {
+        size_t grown = capacity ? capacity * 2 : 1024;
+        replay_call_t* calls = realloc(g_calls, grown * sizeof *calls);
+        if (!calls)
+        {
+            return -1;
+        }
+        g_calls = calls;
+        capacity = grown;
+    }
+    // Store the call, times are made relative once the trace is loaded
+    replay_call_t* c = &g_calls[g_n_calls++];
+    c->at_ms = (long)unix_ms;
+    c->wall = (time_t)(unix_ms / 1000u);
+    c->src_floor = src_floor;
+    c->dst_floor = dst_floor;
+    c->car = -1;
+    c->eta_ms = 0;
+    c->pickup_ms = -1;
+    c->dropoff_ms = -1;
+    return 0;
+}
+
+static int load_journal(FILE* in)
+{
+    // Check the header describes records this build understands
+    journal_header_t header;
+    if (fread(&header, sizeof header, 1, in) != 1 || header.version != JOURNAL_VERSION ||
+        header.record_size != sizeof(journal_record_t))
+    {
+        fprintf(stderr, "Unsupported journal\n");
+        return -1;
+    }
+    // Read every reserved slot, skipping those a crash left torn
+    journal_record_t r;
+    for (uint64_t i = 0; i < header.next_slot && fread(&r, sizeof r, 1, in) == 1; ++i)
+    {
+        if (!r.commit)
+        {
+            continue;
+        }
+        if (r.type == JOURNAL_CALL && add_call(r.time_ns / 1000000u, r.src_floor, r.dst_floor) == -1)
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int load_text(FILE* in)
+{
+    char line[128];
+    int line_no = 0;
+    // Read one "<unix_ms> <src> <dst>" call per line
+    while (fgets(line, sizeof line, in))
+    {
+        line_no++;
+        unsigned long long unix_ms;
+        char src[8], dst[8];
+        int src_floor, dst_floor;
+        // Skip blank lines and comments
+        if (line[0] == '#' || line[0] == '\n')
+        {
+            continue;
+        }
+        if (sscanf(line, "%llu %7s %7s", &unix_ms, src, dst) != 3 ||
+            !floor_num_handler(src, &src_floor) || !floor_num_handler(dst, &dst_floor))
+        {
+            fprintf(stderr, "Invalid call on line %d\n", line_no);
+            return -1;
+        }
+        if (add_call(unix_ms, src_floor, dst_floor) == -1)
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int cmp_call(const void* a, const void* b)
+{
+    // Order calls by time
+    long x = ((const replay_call_t*)a)->at_ms;
+    long y = ((const replay_call_t*)b)->at_ms;
+    return (x > y) - (x < y);
+}
+
+static int load_trace(const char* path)
+{
+    FILE* in = fopen(path, "rb");
+    if (!in)
+    {
+        perror("Trace open error");
+        return -1;
+    }
+    // Journals are recognised by their magic, anything else is text
+    char magic[sizeof JOURNAL_MAGIC - 1];
+    int is_journal = fread(magic, 1, sizeof magic, in) == sizeof magic &&
+                     memcmp(magic, JOURNAL_MAGIC, sizeof magic) == 0;
+    rewind(in);
+    int err = is_journal ? load_journal(in) : load_text(in);
+    fclose(in);
+    if (err != 0 || g_n_calls == 0)
+    {
+        return -1;
+    }
+    // Journal records are in publish order, which may differ slightly from
+    // call order, so sort then make times relative to the first call
+    qsort(g_calls, g_n_calls, sizeof *g_calls, cmp_call);
+    long first = g_calls[0].at_ms;
+    for (size_t i = 0; i < g_n_calls; ++i)
+    {
+        g_calls[i].at_ms -= first;
+    }
+    return 0;
+}
+
+//                  Car Simulation                 //
+
+static void sim_status(int i, const char* status, int phase, long duration)
+{
+    CarID* car = &g_cars[i];
+    sim_car_t* s = &g_sim[i];
+    // Enter the phase
+    s->phase = phase;
+    s->until_ms = g_now_ms + duration;
+    // Report the status to the dispatcher the way a car's STATUS frame would
+    char cur[4], dst[4];
+    index_handler(s->floor, cur);
+    index_handler(car->queue_len > 0 ? car->q[0] : s->floor, dst);
+    car_observe(car, status, cur, dst, g_now_ms);
+    (void)car_schedule(car, g_now_ms);
+}
+
+static void sim_depart(int i)
+{
+    CarID* car = &g_cars[i];
+    sim_car_t* s = &g_sim[i];
+    // Wait for work with the doors closed
+    if (car->queue_len == 0)
+    {
+        s->phase = SIM_IDLE;
+        s->until_ms = LONG_MAX;
+        return;
+    }
+    // Open at the head of the queue or travel towards it
+    if (car->q[0] == s->floor)
+    {
+        sim_status(i, "Opening", SIM_OPENING, g_delay_ms);
+    }
+    else
+    {
+        sim_status(i, "Between", SIM_BETWEEN, g_delay_ms);
+    }
+}
+
+static void sim_advance(int i)
+{
+    sim_car_t* s = &g_sim[i];
+    switch (s->phase)
+    {
+        case SIM_BETWEEN:
+            // Arrive at the next floor towards the head, skipping floor 0
+            s->floor += (g_cars[i].q[0] > s->floor) ? 1 : -1;
+            if (s->floor == 0)
+            {
+                s->floor += (g_cars[i].q[0] > 0) ? 1 : -1;
+            }
+            sim_status(i, "Closed", SIM_IDLE, 0);
+            sim_depart(i);
+            break;
+        case SIM_OPENING:
+            sim_status(i, "Open", SIM_OPEN, g_delay_ms);
+            break;
+        case SIM_OPEN:
+            sim_status(i, "Closing", SIM_CLOSING, g_delay_ms);
+            break;
+        case SIM_CLOSING:
+            sim_status(i, "Closed", SIM_IDLE, 0);
+            sim_depart(i);
+            break;
+        default:
+            break;
+    }
+}
+
+static void sim_wake(int i)
+{
+    // Idle cars start moving as soon as they are given work
+    if (g_sim[i].phase == SIM_IDLE)
+    {
+        sim_depart(i);
+    }
+}
+
+static void replay_trip(trip_event_t event, const CarID* car, const trip_t* trip, long eta_ms)
+{
+    // Trip ids are call indexes offset by one
+    replay_call_t* c = &g_calls[trip->id - 1];
+    switch (event)
+    {
+        case TRIP_ASSIGN:
+            c->car = (int)(car - g_cars);
+            c->eta_ms = eta_ms;
+            break;
+        case TRIP_PICKUP:
+            c->pickup_ms = g_now_ms;
+            break;
+        case TRIP_DROPOFF:
+            c->dropoff_ms = g_now_ms;
+            break;
+    }
+}
+
+//                  Dispatch                 //
+
+static void dispatch_one(size_t c)
+{
+    replay_call_t* rc = &g_calls[c];
+    // Choose a car exactly as the controller does without a batch window
+    int i = select_car(g_cars, g_n_cars, rc->src_floor, rc->dst_floor, g_dd_span, g_now_ms, traffic_slot(rc->wall));
+    if (i < 0)
+    {
+        return;
+    }
+    CarID* car = &g_cars[i];
+    enqueue(car, rc->src_floor, rc->dst_floor);
+    route_refresh(car, g_now_ms);
+    trip_assign(car, (uint32_t)(c + 1), rc->src_floor, rc->dst_floor, car_eta_ms(car, rc->src_floor, g_now_ms));
+    sim_wake(i);
+}
+
+static void dispatch_batch(const size_t ids[], int n)
+{
+    dispatch_call_t req[MAX_BATCH];
+    int car_of[MAX_BATCH];
+    // Solve the window jointly in the slot of its last call
+    for (int k = 0; k < n; ++k)
+    {
+        req[k].src_floor = g_calls[ids[k]].src_floor;
+        req[k].dst_floor = g_calls[ids[k]].dst_floor;
+    }
+    batch_assign(g_cars, g_n_cars, req, n, g_dd_span, g_now_ms, traffic_slot(g_calls[ids[n - 1]].wall), car_of);
+    // Track each assigned trip and start the cars
+    for (int k = 0; k < n; ++k)
+    {
+        if (car_of[k] < 0)
+        {
+            continue;
+        }
+        CarID* car = &g_cars[car_of[k]];
+        trip_assign(car, (uint32_t)(ids[k] + 1), req[k].src_floor, req[k].dst_floor, car_eta_ms(car, req[k].src_floor, g_now_ms));
+        sim_wake(car_of[k]);
+    }
+}
+
+static void run(void)
+{
+    size_t next = 0;
+    size_t batch[MAX_BATCH];
+    int batch_len = 0;
+    long batch_close = LONG_MAX;
+
+    for (;;)
+    {
+        // Find the next car to change phase
+        int who = -1;
+        long t_car = LONG_MAX;
+        for (int i = 0; i < g_n_cars; ++i)
+        {
+            if (g_sim[i].until_ms < t_car)
+            {
+                t_car = g_sim[i].until_ms;
+                who = i;
+            }
+        }
+        long t_call = next < g_n_calls ? g_calls[next].at_ms : LONG_MAX;
+
+        // Cars move first at equal times, then the batch closes, then calls arrive
+        if (who >= 0 && t_car <= batch_close && t_car <= t_call)
+        {
+            g_now_ms = t_car;
+            sim_advance(who);
+        }
+        else if (batch_len > 0 && batch_close <= t_call)
+        {
+            g_now_ms = batch_close;
+            dispatch_batch(batch, batch_len);
+            batch_len = 0;
+            batch_close = LONG_MAX;
+        }
+        else if (next < g_n_calls)
+        {
+            g_now_ms = t_call;
+            replay_call_t* rc = &g_calls[next];
+            // Count the call for demand forecasting like the controller
+            traffic_record(rc->src_floor, rc->dst_floor, rc->wall, g_now_ms);
+            if (g_batch_window_ms <= 0)
+            {
+                dispatch_one(next);
+            }
+            else
+            {
+                // The first call opens the window and a full batch closes it early
+                batch[batch_len++] = next;
+                if (batch_len == 1)
+                {
+                    batch_close = g_now_ms + g_batch_window_ms;
+                }
+                if (batch_len == MAX_BATCH)
+                {
+                    batch_close = g_now_ms;
+                }
+            }
+            next++;
+        }
+        else
+        {
+            // No calls, batches or moving cars remain
+            break;
+        }
+    }
+}
+
+//                  Statistics                 //
+
+static int cmp_long(const void* a, const void* b)
+{
+    long x = *(const long*)a, y = *(const long*)b;
+    return (x > y) - (x < y);
+}
+
+static void print_stat(const char* label, long* v, size_t n)
+{
+    if (n == 0)
+    {
+        printf("%-10s %10s\n", label, "-");
+        return;
+    }
+    // Sort for percentiles and sum for the mean
+    qsort(v, n, sizeof *v, cmp_long);
+    double sum = 0.0;
+    for (size_t i = 0; i < n; ++i)
+    {
+        sum += (double)v[i];
+    }
+    printf("%-10s %10.0f %10ld %10ld %10ld\n", label, sum / (double)n,
+           v[n / 2], v[(n * 95) / 100 < n ? (n * 95) / 100 : n - 1], v[n - 1]);
+}
+
+static int report(void)
+{
+    long* wait = malloc(g_n_calls * sizeof *wait);
+    long* ride = malloc(g_n_calls * sizeof *ride);
+    long* journey = malloc(g_n_calls * sizeof *journey);
+    long* eta_err = malloc(g_n_calls * sizeof *eta_err);
+    if (!wait || !ride || !journey || !eta_err)
+    {
+        free(wait);
+        free(ride);
+        free(journey);
+        free(eta_err);
+        return -1;
+    }
+    size_t n_done = 0, n_wait = 0, rejected = 0, unfinished = 0;
+    // Gather per-passenger times from completed stages
+    for (size_t i = 0; i < g_n_calls; ++i)
+    {
+        const replay_call_t* c = &g_calls[i];
+        if (c->car < 0)
+        {
+            rejected++;
+            continue;
+        }
+        if (c->pickup_ms >= 0)
+        {
+            wait[n_wait] = c->pickup_ms - c->at_ms;
+            long err = wait[n_wait] - c->eta_ms;
+            eta_err[n_wait++] = err < 0 ? -err : err;
+        }
+        if (c->dropoff_ms < 0)
+        {
+            unfinished++;
+            continue;
+        }
+        ride[n_done] = c->dropoff_ms - c->pickup_ms;
+        journey[n_done++] = c->dropoff_ms - c->at_ms;
+    }
+    // Print a summary table
+    printf("calls %zu  served %zu  rejected %zu  unfinished %zu  cars %d  simulated %.1f s\n",
+           g_n_calls, n_done, rejected, unfinished, g_n_cars, (double)g_now_ms / 1000.0);
+    printf("%-10s %10s %10s %10s %10s\n", "(ms)", "mean", "p50", "p95", "max");
+    print_stat("wait", wait, n_wait);
+    print_stat("ride", ride, n_done);
+    print_stat("journey", journey, n_done);
+    print_stat("eta error", eta_err, n_wait);
+    free(wait);
+    free(ride);
+    free(journey);
+    free(eta_err);
+    return 0;
+}
+
+//                  Main                 //
+
+static int add_car(const char* spec)
+{
+    char name[32], low[8], high[8];
+    int lowest, highest;
+    // Parse name:lowest:highest
+    if (g_n_cars == MAX_CARS || sscanf(spec, "%31[^:]:%7[^:]:%7s", name, low, high) != 3 ||
+        !floor_num_handler(low, &lowest) || !floor_num_handler(high, &highest))
+    {
+        return -1;
+    }
+    if (lowest > highest)
+    {
+        int swap = lowest;
+        lowest = highest;
+        highest = swap;
+    }
+    // Register the car closed at its lowest floor like a fresh car
+    CarID* car = &g_cars[g_n_cars];
+    memset(car, 0, sizeof *car);
+    car->in_use = 1;
+    car->shm_fd = -1;
+    car->socket_fd = -1;
+    strncpy(car->name, name, sizeof car->name - 1);
+    car->lowest_floor = lowest;
+    car->highest_floor = highest;
+    strcpy(car->status, "Closed");
+    index_handler(lowest, car->cur_floor);
+    index_handler(lowest, car->dst_floor);
+    car_model_reset(car, 0);
+    g_sim[g_n_cars].floor = lowest;
+    g_sim[g_n_cars].phase = SIM_IDLE;
+    g_sim[g_n_cars].until_ms = LONG_MAX;
+    g_n_cars++;
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    int opt;
+    bool usage = false;
+    // Parse dispatch and simulation options
+    while ((opt = getopt(argc, argv, "b:c:d:D:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'b':
+                g_batch_window_ms = strtol(optarg, NULL, 10);
+                break;
+            case 'c':
+                if (add_car(optarg) == -1)
+                {
+                    fprintf(stderr, "Invalid car: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'd':
+                g_dd_span = (int)strtol(optarg, NULL, 10);
+                break;
+            case 'D':
+                g_delay_ms = strtol(optarg, NULL, 10);
+                break;
+            default:
+                usage = true;
+                break;
+        }
+    }
+    if (usage || optind != argc - 1 || g_n_cars == 0 || g_delay_ms <= 0)
+    {
+        fprintf(stderr, "Usage: %s -c name:lowest:highest [-c ...] [-b batch_window_ms] [-d dd_span_floors] [-D delay_ms] trace\n", argv[0]);
+        return 1;
+    }
+
+    // Load the calls to replay
+    if (load_trace(argv[optind]) == -1)
+    {
+        fprintf(stderr, "No calls loaded from %s\n", argv[optind]);
+        return 1;
+    }
+
+    // Replay every call through the dispatcher and report the outcome
+    // Counters decay over the trace's own time, as they did live
+    traffic_init(86400.0, g_now_ms);
+    dispatch_set_trip_hook(replay_trip);
+    run();
+    int err = report();
+    free(g_calls);
+    return err == 0 ? 0 : 1;
+}
@@ -21,9 +21,11 @@
        checked to ensure initialization integrity.
 
     2. Diagnostic I/O:
-       Blocking I/O (printf) is used strictly for operator feedback and diagnostics. In a 
-       bare-metal deployment, this would be replaced by a deterministic logging mechanism 
-       or memory-mapped I/O to avoid non-deterministic blocking behavior.
+       The monitoring loop never writes to the terminal. Violations are appended, with a
+       snapshot of the car's state, to a lock-free event ring in the car's shared memory;
+       a separate logger thread drains the rings into the non-blocking log, so a slow
+       terminal delays the report and never the next check. A full ring drops and counts
+       events rather than waiting.
 
     3. Error Handling Strategy:
        Initialization errors are strictly handled (fail-safe). Runtime synchronization 
@@ -36,8 +38,18 @@
 #ifndef _POSIX_C_SOURCE
 #define _POSIX_C_SOURCE 200809L
 #endif
+// syscall() for the futex helpers in shm_sync.h
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif
 
 #include "shared.h"
+#include "shm_sync.h"
+#include "safety_model.h"
+#include "safety_rules.h"
+#include "log.h"
+#include "parse_util.h"
+#include "time_util.h"
 
 #include <sys/mman.h>
 #include <pthread.h>
@@ -49,91 +61,360 @@
 #include <fcntl.h>
 #include <signal.h>
 #include <errno.h>
+#include <time.h>
+#include <stdbool.h>
 
 //                  Macros                  //
-#define CAR_LOCK(shm)   pthread_mutex_lock(&(shm)->mutex)
+#define CAR_LOCK(shm)   shm_lock(shm)
 #define CAR_UNLOCK(shm) pthread_mutex_unlock(&(shm)->mutex)
-#define CAR_NOTIFY(shm) pthread_cond_broadcast(&(shm)->cond)
-
-// Shared Memory
-char g_shm_name[32];
-static car_shared_mem *g_shm_ptr = NULL;
+#define CAR_NOTIFY(shm, topics) shm_notify((shm), (topics))
+// Invariants are checked at least this often, car activity or not
+#define SAFETY_PERIOD_MS 50u
+// Longest wait for a car's mutex before its check is deferred to the next pass
+#define SAFETY_LOCK_MS 5u
+// Age of a car's heartbeat at which the car is reported unresponsive
+#define SAFETY_CAR_TIMEOUT_MS 500u
+
+// Structure to hold one monitored car
+typedef struct
+{
+    const char* name;
+    car_shared_mem* shm;
+    uint32_t seen;                     // change_seq when last checked
+    unsigned long long checks;         // Checks completed
+    unsigned long long lock_timeouts;  // Checks deferred because the mutex was held
+    long long worst_check_ns;          // Longest check with the mutex held
+    bool lost;                         // Heartbeat timed out and has not resumed
+} monitored_car_t;
+
+// Shared Memory of every monitored car
+static monitored_car_t g_cars[SHM_WAIT_MAX];
+static int g_n_cars = 0;
 
 //                  Status Flags                    //
 static volatile sig_atomic_t g_shutdown = 0;
 
+// Wakes the logger thread when events were appended
+static pthread_mutex_t g_log_mx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_log_cv = PTHREAD_COND_INITIALIZER;
+static int g_log_pending = 0;
+
 static void on_SIGINT(int sig)
 {
     (void)sig;
-    // Set shutdown flag
+    // Set shutdown flag; the wait returns EINTR so the loop sees it
     g_shutdown = 1;
+}
+
+
+//                  Invariant Checks                  //
 
-    // Check for shared memory
-    if (g_shm_ptr)
+// Actions and operator messages of each rule, in rule order
+typedef struct
+{
+    unsigned actions;
+    const char* message;
+} rule_outcome_t;
+
+static const rule_outcome_t g_rule_outcomes[] = {
+#define SAFETY_RULE(name, states, set, clear, actions, message) {(actions), (message)},
+#include "safety_rules.def"
+#undef SAFETY_RULE
+};
+
+// Number of rules in safety_rules.def
+#define N_RULE_OUTCOMES (sizeof g_rule_outcomes / sizeof g_rule_outcomes[0])
+
+// Outcome of rule number code, or NULL if no rule has that number
+static const rule_outcome_t* rule_outcome(unsigned code)
+{
+    // Rules are numbered from 1; 0 means no rule fired
+    if (code < 1u || code > N_RULE_OUTCOMES)
     {
-        // If shared memory is mapped lock the mutex
-        CAR_LOCK(g_shm_ptr);
-        // Notify all waiting threads
-        pthread_cond_broadcast(&g_shm_ptr->cond);
-        // Unlock the mutex
-        CAR_UNLOCK(g_shm_ptr);
+        return NULL;
     }
+    return &g_rule_outcomes[code - 1u];
 }
 
+static safety_state_t state_code(const char* status)
+{
+    // One comparison once the first letter narrows the candidates
+    switch (status[0])
+    {
+        case 'C':
+            if (strcmp(status, "Closed") == 0) return SAFETY_CLOSED;
+            if (strcmp(status, "Closing") == 0) return SAFETY_CLOSING;
+            return SAFETY_INVALID;
+        case 'O':
+            if (strcmp(status, "Opening") == 0) return SAFETY_OPENING;
+            if (strcmp(status, "Open") == 0) return SAFETY_OPEN;
+            return SAFETY_INVALID;
+        case 'B':
+            return strcmp(status, "Between") == 0 ? SAFETY_BETWEEN : SAFETY_INVALID;
+        default:
+            return SAFETY_INVALID;
+    }
+}
 
-//                  Floor Handlers                  //
-static int floor_num_handler(const char *f, int *out)
+// Check a car's invariants and apply any safety response. Called with
+// the car's mutex held; returns the violated rule's number (0 if none) and
+// fills in the event to report it with.
+static unsigned safety_check(car_shared_mem* m, safety_event_t* event)
 {
-    // Check to ensure that f is valid
-    if (!f || !*f)
+    // If the safety system is a value other than 1
+    if(m->safety_system != 1)
     {
+        // set safety system to 1
+        m->safety_system = 1;
+        // Notify the system of status change
+        CAR_NOTIFY(m, SHM_MODES);
+    }
+
+    // Sample the inputs the rules are written over
+    int floor;
+    unsigned flags = m->open_button | m->close_button | m->door_obstruction | m->overload |
+                     m->emergency_stop | m->individual_service_mode | m->emergency_mode;
+    unsigned inputs =
+        (m->door_obstruction == 1 ? IN_OBSTRUCTION : 0u) |
+        (m->overload == 1 ? IN_OVERLOAD : 0u) |
+        (m->emergency_stop == 1 ? IN_EMERGENCY_STOP : 0u) |
+        (m->emergency_mode == 1 ? IN_EMERGENCY_MODE : 0u) |
+        (flags <= 1u ? IN_FIELDS_VALID : 0u) |
+        (floor_num_handler(m->current_floor, &floor) && floor_num_handler(m->destination_floor, &floor)
+            ? IN_FLOORS_VALID : 0u);
+
+    // Look up the outcome compiled from safety_rules.def
+    unsigned entry = g_safety_table[SAFETY_KEY(state_code(m->status), inputs)];
+    if (entry & SAFETY_ENTRY_REOPEN)
+    {
+        // If obstruction was detected swtich status to opening
+        strcpy(m->status, "Opening");
+        // Notify the system of status change
+        CAR_NOTIFY(m, SHM_DOORS);
+    }
+    if (SAFETY_ENTRY_RULE(entry) == 0)
+    {
+        // All invariants hold
         return 0;
     }
+    const rule_outcome_t* rule = rule_outcome(SAFETY_ENTRY_RULE(entry));
+    // Set emergency mode, clearing the stop button if the rule says so; a
+    // rule number the table does not know still stops the car
+    m->emergency_mode = 1;
+    if (rule && (rule->actions & ACT_CLEAR_STOP))
+    {
+        m->emergency_stop = 0;
+    }
+    // Notify the system of status change
+    CAR_NOTIFY(m, SHM_MODES);
+    // Snapshot the state the rule fired on for the report
+    memset(event, 0, sizeof *event);
+    event->code = (uint8_t)SAFETY_ENTRY_RULE(entry);
+    event->inputs = (uint8_t)inputs;
+    memcpy(event->status, m->status, sizeof event->status);
+    memcpy(event->current_floor, m->current_floor, sizeof event->current_floor);
+    memcpy(event->destination_floor, m->destination_floor, sizeof event->destination_floor);
+    return SAFETY_ENTRY_RULE(entry);
+}
+
+
+//                  Supervision                  //
+
+static void report(monitored_car_t* car, safety_event_t* event)
+{
+    // Hand the event to the logger thread; never blocks on the terminal
+    event->time_ns = shm_now_ns();
+    shm_event_push(&car->shm->safety_events, event);
+    pthread_mutex_lock(&g_log_mx);
+    g_log_pending = 1;
+    pthread_cond_signal(&g_log_cv);
+    pthread_mutex_unlock(&g_log_mx);
+}
+
+static void check_car(monitored_car_t* car)
+{
+    // A car whose mutex stays held is skipped this pass, not waited on,
+    // so one faulty car cannot delay the others' emergency actions
+    if (shm_lock_timed(car->shm, SAFETY_LOCK_MS) != 0)
+    {
+        car->lock_timeouts++;
+        // Leave it to the scheduled pass rather than waking again at once
+        car->seen = shm_change_seq(car->shm);
+        return;
+    }
+    long long start_ns = mono_ns();
+    safety_event_t event;
+    unsigned rule = safety_check(car->shm, &event);
+    // Changes up to here, including our own notify, have been checked
+    car->seen = shm_change_seq(car->shm);
+    long long check_ns = mono_ns() - start_ns;
+    // Unlock mutex before reporting to the operator
+    CAR_UNLOCK(car->shm);
+
+    car->checks++;
+    if (check_ns > car->worst_check_ns)
+    {
+        car->worst_check_ns = check_ns;
+    }
+    if (rule)
+    {
+        report(car, &event);
+    }
+}
+
+static void exchange_heartbeat(monitored_car_t* car, unsigned timeout_ms)
+{
+    // Tell the car the monitor is alive
+    shm_beat(&car->shm->safety_beat_ns);
+    // Report a car that stopped beating, once until it recovers
+    bool stale = shm_beat_age_ms(&car->shm->car_beat_ns) > timeout_ms;
+    if (stale != car->lost)
+    {
+        safety_event_t event;
+        memset(&event, 0, sizeof event);
+        event.code = stale ? SAFETY_EVENT_CAR_LOST : SAFETY_EVENT_CAR_RESUMED;
+        report(car, &event);
+    }
+    car->lost = stale;
+}
 
-    // Handle negative conversions for basement floors (b or B)
-    if (f[0] == 'b' || f[0] == 'B')
+//                  Logger                  //
+
+static void drain_events(void)
+{
+    safety_event_t event;
+    for (int i = 0; i < g_n_cars; ++i)
     {
-        // Convert the string to long integer ingoring leading B/b
-        char *end = NULL;
-        long i = strtol(f + 1, &end, 10);
-        // Check to make sure floor has been parsed
-        // and is within 1 to 99
-        if (end == f + 1 || i < 1 || i > 99)
+        monitored_car_t* car = &g_cars[i];
+        while (shm_event_pop(&car->shm->safety_events, &event))
         {
-            return 0;
+            const char* message = NULL;
+            if (event.code == SAFETY_EVENT_CAR_LOST)
+            {
+                message = "Heartbeat lost!";
+            }
+            else if (event.code == SAFETY_EVENT_CAR_RESUMED)
+            {
+                message = "Heartbeat resumed.";
+            }
+            else
+            {
+                const rule_outcome_t* rule = rule_outcome(event.code);
+                if (rule)
+                {
+                    message = rule->message;
+                }
+            }
+            // The ring sits in shared memory, so a code may match no rule,
+            // or a rule with nothing to tell the operator
+            if (!message)
+            {
+                LOG_ERROR("Car %s: unknown safety event code %u.", car->name, (unsigned)event.code);
+                continue;
+            }
+            // Name the car when several are monitored
+            if (g_n_cars > 1)
+            {
+                LOG_WARN("Car %s: %s", car->name, message);
+            }
+            else
+            {
+                LOG_WARN("%s", message);
+            }
+        }
+        // Say how many reports a full ring cost since the last drain
+        uint32_t dropped = atomic_exchange((_Atomic uint32_t*)&car->shm->safety_events.dropped, 0u);
+        if (dropped)
+        {
+            LOG_ERROR("Car %s: %u safety events dropped.", car->name, (unsigned)dropped);
         }
-        // Valid floor is passed to pointer and returns successfully
-        *out = -(int)i;
-        return 1;
     }
-    // Otherwise handle positive floor numbers
-    else
+}
+
+static void* logger_thread(void* arg)
+{
+    (void)arg;
+    for (;;)
     {
-        // Convert the string to long integer
-        char *end = NULL;
-        long i = strtol(f, &end, 10);
-        // Check to make sure floor has been parsed
-        // and is within 1 to 999
-        if (end == f || i < 1 || i > 999)
+        // Sleep until the monitoring loop reports or shuts down
+        pthread_mutex_lock(&g_log_mx);
+        while (!g_log_pending && !g_shutdown)
         {
-            return 0;
+            pthread_cond_wait(&g_log_cv, &g_log_mx);
+        }
+        g_log_pending = 0;
+        pthread_mutex_unlock(&g_log_mx);
+        // Print outside the lock so reporting never holds up the loop
+        drain_events();
+        if (g_shutdown)
+        {
+            break;
         }
-        // Valid floor is passed to pointer and returns successfully
-        *out = (int)i;
-        return 1;
     }
+    return NULL;
 }
 
+static int attach_car(const char* car_name)
+{
+    // Create shared memory frame
+    char shm_name[40];
+    snprintf(shm_name, sizeof(shm_name), "/car%s", car_name);
+    int fd = shm_open(shm_name, O_RDWR, 0666);
+    if(fd == -1)
+    {
+        fprintf(stderr, "Unable to access car %s.\n", car_name);
+        return -1;
+    }
+
+    // Map shared memory
+    car_shared_mem* shm = mmap(NULL, sizeof(car_shared_mem), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (shm == MAP_FAILED)
+    {
+        perror("mmap failed");
+        return -1;
+    }
+    monitored_car_t* car = &g_cars[g_n_cars++];
+    memset(car, 0, sizeof *car);
+    car->name = car_name;
+    car->shm = shm;
+    // Force a first check of every car
+    car->seen = shm_change_seq(shm) - 1u;
+    return 0;
+}
 
 //                  Main                    //
 int main(int argc, char *argv[])
 {
-    if (argc != 2)
+    // Longest time between checks while the cars are quiet, and the car
+    // heartbeat age reported as a lost car
+    unsigned period_ms = SAFETY_PERIOD_MS;
+    unsigned car_timeout_ms = SAFETY_CAR_TIMEOUT_MS;
+    int first_car = 1;
+    while (argc - first_car >= 2 && (strcmp(argv[first_car], "-p") == 0 || strcmp(argv[first_car], "-t") == 0))
+    {
+        char* end = NULL;
+        unsigned long v = strtoul(argv[first_car + 1], &end, 10);
+        if (end == argv[first_car + 1] || *end != '\0' || v == 0 || v > 60000)
+        {
+            fprintf(stderr, "Invalid %s.\n", argv[first_car][1] == 'p' ? "period" : "timeout");
+            return 1;
+        }
+        if (argv[first_car][1] == 'p')
+        {
+            period_ms = (unsigned)v;
+        }
+        else
+        {
+            car_timeout_ms = (unsigned)v;
+        }
+        first_car += 2;
+    }
+    if (argc - first_car < 1 || argc - first_car > SHM_WAIT_MAX)
     {
-        fprintf(stderr, "Usage: %s {car name}\n", argv[0]);
+        fprintf(stderr, "Usage: %s [-p period_ms] [-t car_timeout_ms] {car name}...\n", argv[0]);
         return 1;
     }
-    const char* car_name = argv[1];
 
     // Signal handling 
     signal(SIGPIPE, SIG_IGN);
@@ -143,130 +424,133 @@ int main(int argc, char *argv[])
     sa.sa_handler = on_SIGINT;
     sigaction(SIGINT, &sa, NULL);
 
-    // Create shared memory frame
-    char shm_name[32];
-    snprintf(shm_name, sizeof(shm_name), "/car%s", car_name);
-    int fd = shm_open(shm_name, O_RDWR, 0666);
-    if(fd == -1)
+    // Map every car's shared memory
+    for (int i = first_car; i < argc; ++i)
     {
-        fprintf(stderr, "Unable to access car %s.\n", car_name);
-        return 1;
+        if (attach_car(argv[i]) == -1)
+        {
+            return 1;
+        }
     }
 
-    // Map shared memory
-    g_shm_ptr = mmap(NULL, sizeof(car_shared_mem), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
-    if (g_shm_ptr == MAP_FAILED)
+    // Reports go through the log; without its flusher there is no one to
+    // tell, so do not monitor at all
+    if (log_init(LOG_LEVEL_INFO, 0) == -1)
     {
-        perror("mmap failed");
-        close(fd);
-        shm_unlink(g_shm_name);
+        fprintf(stderr, "Unable to start the log flusher\n");
         return 1;
     }
-    close(fd);
+    // Start the logger with SIGINT blocked so the signal interrupts the
+    // monitoring loop's wait instead
+    sigset_t block, old_mask;
+    sigemptyset(&block);
+    sigaddset(&block, SIGINT);
+    pthread_sigmask(SIG_BLOCK, &block, &old_mask);
+    pthread_t logger_tid;
+    if (pthread_create(&logger_tid, NULL, logger_thread, NULL) != 0)
+    {
+        perror("pthread_create");
+        return 1;
+    }
+    pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
+
+    // Worst-case figures behind the detection bound reported at exit
+    const long long period_ns = (long long)period_ms * 1000000LL;
+    unsigned long long passes = 0, scheduled = 0, overruns = 0;
+    long long worst_late_ns = 0;
+    car_shared_mem* shms[SHM_WAIT_MAX];
+    uint32_t seen[SHM_WAIT_MAX];
+    for (int i = 0; i < g_n_cars; ++i)
+    {
+        shms[i] = g_cars[i].shm;
+    }
 
+    // Check each car when it signals a change, and every car each period
+    long long deadline_ns = mono_ns() + period_ns;
     while(!g_shutdown)
     {
-        CAR_LOCK(g_shm_ptr);
-
-        pthread_cond_wait(&g_shm_ptr->cond, &g_shm_ptr->mutex);
-
-        // If the safety system is a value other than 1
-        if(g_shm_ptr->safety_system != 1)
+        // Sleep on every car's change word at once until one moves or the
+        // period elapses
+        for (int i = 0; i < g_n_cars; ++i)
         {
-            // set safety system to 1
-            g_shm_ptr->safety_system = 1;
-            // Notify the system of status change
-            CAR_NOTIFY(g_shm_ptr);
+            seen[i] = g_cars[i].seen;
         }
-
-        // Check for door obstructions while closing
-        if(strcmp(g_shm_ptr->status,"Closing") == 0 && g_shm_ptr->door_obstruction == 1)
+        struct timespec deadline = ns_to_timespec(deadline_ns);
+        if (shm_wait_any(shms, seen, g_n_cars, &deadline) == -1 && errno != ETIMEDOUT && errno != EINTR)
         {
-            // If obstruction was detected swtich status to opening
-            strcpy(g_shm_ptr->status, "Opening");
-            // Notify the system of status change
-            CAR_NOTIFY(g_shm_ptr);
+            LOG_ERROR("Wait error: %s", strerror(errno));
+            break;
         }
-
-        if(g_shm_ptr->emergency_stop == 1 && g_shm_ptr->emergency_mode == 0)
+        long long start_ns = mono_ns();
+        bool all = start_ns >= deadline_ns;
+        if (all)
         {
-            // Set emergency mode and clear the stop
-            g_shm_ptr->emergency_mode = 1;
-            g_shm_ptr->emergency_stop = 0;
-            // Notify the system of status chane
-            CAR_NOTIFY(g_shm_ptr);
-            // Unlock the mutex and print message to the operator
-            CAR_UNLOCK(g_shm_ptr);
-            printf("The emergency stop button has been pressed!\n");
-            // Pass to wait for next signal
-            continue;
+            // Scheduled pass: record how late it started and skip any
+            // periods missed entirely so the schedule does not drift
+            scheduled++;
+            if (start_ns - deadline_ns > worst_late_ns)
+            {
+                worst_late_ns = start_ns - deadline_ns;
+            }
+            deadline_ns += period_ns;
+            while (deadline_ns <= start_ns)
+            {
+                deadline_ns += period_ns;
+                overruns++;
+            }
         }
 
-        if(g_shm_ptr->overload == 1 && g_shm_ptr->emergency_mode == 0)
+        // Check cars that changed, or all of them on schedule
+        passes++;
+        for (int i = 0; i < g_n_cars; ++i)
         {
-            // Set emergency mode
-            g_shm_ptr->emergency_mode = 1;
-            // Notify the system of status change
-            CAR_NOTIFY(g_shm_ptr);
-            // Unlock the mutex and print message to the operator
-            CAR_UNLOCK(g_shm_ptr);
-            printf("The overload sensor has been tripped!\n");
-            // Elevator is to wait for a following signal to proceed
-            continue;
+            // Heartbeats go both ways once per period, independent of the checks
+            if (all)
+            {
+                exchange_heartbeat(&g_cars[i], car_timeout_ms);
+            }
+            if (all || shm_change_seq(g_cars[i].shm) != g_cars[i].seen)
+            {
+                check_car(&g_cars[i]);
+            }
         }
+    }
 
-        // Check to make sure that the status is one of the 5 validated statuses
-        int is_valid_status = (
-            strcmp(g_shm_ptr->status,"Closed") == 0 ||
-            strcmp(g_shm_ptr->status,"Opening") == 0 || 
-            strcmp(g_shm_ptr->status,"Open") == 0 || 
-            strcmp(g_shm_ptr->status,"Closing") == 0 ||
-            strcmp(g_shm_ptr->status,"Between") == 0
-        );
-
-        int valid_floor;
-        // Parse floors and store results
-        int valid_cur_floor = floor_num_handler(g_shm_ptr->current_floor, &valid_floor);
-        int valid_dst_floor = floor_num_handler(g_shm_ptr->destination_floor, &valid_floor);
-
-        // Store if the fields in the struct are valid
-        int are_valid_fields = (
-            ((g_shm_ptr->open_button == 0) || (g_shm_ptr->open_button == 1)) &&
-            ((g_shm_ptr->close_button == 0) || (g_shm_ptr->close_button == 1)) &&
-            ((g_shm_ptr->door_obstruction == 0) || (g_shm_ptr->door_obstruction == 1)) &&
-            ((g_shm_ptr->overload == 0) || (g_shm_ptr->overload == 1)) &&
-            ((g_shm_ptr->emergency_stop == 0) || (g_shm_ptr->emergency_stop == 1)) &&
-            ((g_shm_ptr->individual_service_mode == 0) || (g_shm_ptr->individual_service_mode == 1)) &&
-            ((g_shm_ptr->emergency_mode == 0) || (g_shm_ptr->emergency_mode == 1))
-        );
-
-        // Store if obstruction status is a valid condition
-        int is_valid_obstruction =  g_shm_ptr->door_obstruction == 1 || (strcmp(g_shm_ptr->status,"Closing") == 0 || strcmp(g_shm_ptr->status,"Opening") == 0);
-
-        // check if emergency mode is active with any invalid circumstances
-        if(g_shm_ptr->emergency_mode != 1 && 
-        (!valid_cur_floor == 1 || 
-         !valid_dst_floor == 1 || 
-         !is_valid_status == 1 || 
-         !are_valid_fields == 1 ||
-         !is_valid_obstruction == 1))
+    // Let the logger print what is left before the summary
+    pthread_mutex_lock(&g_log_mx);
+    g_shutdown = 1;
+    pthread_cond_signal(&g_log_cv);
+    pthread_mutex_unlock(&g_log_mx);
+    pthread_join(logger_tid, NULL);
+
+    // Any violation is seen within a period plus the worst wake-up delay and check
+    long long worst_check_ns = 0;
+    unsigned long long checks = 0, lock_timeouts = 0;
+    for (int i = 0; i < g_n_cars; ++i)
+    {
+        checks += g_cars[i].checks;
+        lock_timeouts += g_cars[i].lock_timeouts;
+        if (g_cars[i].worst_check_ns > worst_check_ns)
         {
-            // Set emergency mode
-            g_shm_ptr->emergency_mode = 1;
-            // Notify the system of status change
-            CAR_NOTIFY(g_shm_ptr);
-            // Unlock the mutex and print message to the operator
-            CAR_UNLOCK(g_shm_ptr);
-            printf("Data consistency error!\n");
-            // Elevator is to wait for a following signal to proceed
-            continue;
+            worst_check_ns = g_cars[i].worst_check_ns;
         }
-        // Unlock mutex and proceed with next check
-        CAR_UNLOCK(g_shm_ptr);
     }
+    // A pass checks the cars one after another, so the last waits on the rest
+    long long pass_ns = (long long)g_n_cars * worst_check_ns;
+    // Flush the reports before the summary, which has too many arguments to log
+    log_shutdown();
+    printf("Safety checks: %llu over %d cars in %llu passes (%llu scheduled, %llu missed periods, "
+           "%llu deferred on a held lock), period %u ms, worst wake-up delay %.3f ms, "
+           "worst check %.3f ms, detection bound %.3f ms\n",
+           checks, g_n_cars, passes, scheduled, overruns, lock_timeouts, period_ms,
+           (double)worst_late_ns / 1e6, (double)worst_check_ns / 1e6,
+           (double)(period_ns + worst_late_ns + pass_ns) / 1e6);
 
     // Unmap memory
-    munmap(g_shm_ptr, sizeof *g_shm_ptr);
+    for (int i = 0; i < g_n_cars; ++i)
+    {
+        munmap(g_cars[i].shm, sizeof *g_cars[i].shm);
+    }
     //success
     return 0;
 
@@ -0,0 +1,50 @@
+#ifndef SAFETY_MODEL_H
+#define SAFETY_MODEL_H
+
+#include <stdint.h>
+
+// Door and motion states a car can report, plus anything else
+typedef enum
+{
+    SAFETY_CLOSED,
+    SAFETY_OPENING,
+    SAFETY_OPEN,
+    SAFETY_CLOSING,
+    SAFETY_BETWEEN,
+    SAFETY_INVALID,
+    SAFETY_STATES
+} safety_state_t;
+
+// State sets a rule applies to
+#define S_CLOSED   (1u << SAFETY_CLOSED)
+#define S_OPENING  (1u << SAFETY_OPENING)
+#define S_OPEN     (1u << SAFETY_OPEN)
+#define S_CLOSING  (1u << SAFETY_CLOSING)
+#define S_BETWEEN  (1u << SAFETY_BETWEEN)
+#define S_INVALID  (1u << SAFETY_INVALID)
+#define S_ANY      ((1u << SAFETY_STATES) - 1u)
+
+// Input bits sampled from shared memory
+#define IN_OBSTRUCTION    (1u << 0)   // door_obstruction is 1
+#define IN_OVERLOAD       (1u << 1)   // overload is 1
+#define IN_EMERGENCY_STOP (1u << 2)   // emergency_stop is 1
+#define IN_EMERGENCY_MODE (1u << 3)   // emergency_mode is 1
+#define IN_FIELDS_VALID   (1u << 4)   // every flag field is 0 or 1
+#define IN_FLOORS_VALID   (1u << 5)   // both floors parse
+#define SAFETY_INPUT_BITS 6
+
+// Effects of a rule on the car
+#define ACT_REOPEN        (1u << 0)   // Closing becomes Opening; later rules see Opening
+#define ACT_EMERGENCY     (1u << 1)   // Enter emergency mode
+#define ACT_CLEAR_STOP    (1u << 2)   // Clear the emergency stop button
+
+// Index of a state and input combination in the compiled table
+#define SAFETY_KEY(state, inputs) (((unsigned)(state) << SAFETY_INPUT_BITS) | (unsigned)(inputs))
+#define SAFETY_KEYS (SAFETY_STATES << SAFETY_INPUT_BITS)
+
+// Table entries name the first terminal rule that fired (1-based, 0 for
+// none) and whether the door was reopened on the way
+#define SAFETY_ENTRY_REOPEN 0x80u
+#define SAFETY_ENTRY_RULE(entry) ((entry) & 0x7Fu)
+
+#endif // SAFETY_MODEL_H
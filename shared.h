@@ -4,10 +4,44 @@
 #include <pthread.h>
 #include <stdint.h>
 
+// Topics a change to the shared memory is announced under
+enum {
+  SHM_TOPIC_MOTION,                // current_floor, destination_floor
+  SHM_TOPIC_DOORS,                 // status, door_obstruction
+  SHM_TOPIC_BUTTONS,               // open_button, close_button
+  SHM_TOPIC_MODES,                 // safety_system, overload, emergency_stop and the modes
+  SHM_TOPICS
+};
+
+// Safety events a car's ring holds (a power of two)
+#define SAFETY_EVENTS 32
+// Event codes after the rule numbers of safety_rules.def
+#define SAFETY_EVENT_CAR_LOST    0xF0u
+#define SAFETY_EVENT_CAR_RESUMED 0xF1u
+
+// One safety event and the state it was raised on
+typedef struct {
+  uint64_t time_ns;                // CLOCK_MONOTONIC time it was raised
+  uint8_t code;                    // Rule number from safety_rules.def, or a SAFETY_EVENT_* code
+  uint8_t inputs;                  // Input bits the rule was matched on (IN_* in safety_model.h)
+  char status[8];                  // Copies of the fields when raised
+  char current_floor[4];
+  char destination_floor[4];
+} safety_event_t;
+
+// Lock-free single-producer single-consumer ring: the car's safety monitor
+// appends and one reader drains, so reporting never blocks a check
+typedef struct {
+  _Alignas(64) uint32_t head;      // Events appended; written by the producer only
+  uint32_t dropped;                // Events lost because the ring was full
+  _Alignas(64) uint32_t tail;      // Events drained; written by the consumer only
+  safety_event_t events[SAFETY_EVENTS];
+} safety_ring_t;
+
 // Shared memory structure for car processes
 typedef struct {
   pthread_mutex_t mutex;           // Locked while accessing struct contents
-  pthread_cond_t cond;             // Signalled when the contents change
+  pthread_cond_t cond;             // Unused; kept so the layout of earlier fields is unchanged
   char current_floor[4];           // C string in the range B99-B1 and 1-999
   char destination_floor[4];       // Same format as above
   char status[8];                  // C string indicating the elevator's status
@@ -19,6 +53,12 @@ typedef struct {
   uint8_t emergency_stop;          // 1 if stop button has been pressed, else 0
   uint8_t individual_service_mode; // 1 if in individual service mode, else 0
   uint8_t emergency_mode;          // 1 if in emergency mode, else 0
+  uint32_t change_seq;             // Generation, bumped on every notify; a futex word for supervisors
+  uint32_t topic_seq[SHM_TOPICS];  // Bumped when a topic changes; futex words for the car
+  uint32_t sleepers;               // Waiters asleep on the futex words; wakes are skipped at 0
+  uint64_t car_beat_ns;            // CLOCK_MONOTONIC time of the car's last heartbeat
+  uint64_t safety_beat_ns;         // CLOCK_MONOTONIC time of the safety monitor's last heartbeat
+  safety_ring_t safety_events;     // Violations recorded by the safety monitor
 } car_shared_mem;
 
 #endif // SHARED_H
\ No newline at end of file
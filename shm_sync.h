@@ -0,0 +1,277 @@
+#ifndef SHM_SYNC_H
+#define SHM_SYNC_H
+
+/* Shared memory synchronisation helpers
+
+    Every change to a car's shared memory is announced under one or more
+    topics (motion, doors, buttons, modes). Each topic has its own futex
+    word in the segment, and change_seq counts every change as a
+    generation. A waiter sleeps with futex_waitv on only the words it cares
+    about, so a button press no longer wakes a process waiting for the car
+    to arrive, and one supervisor can sleep on the generations of many cars
+    at once. Writers skip the wake syscalls while nobody is asleep.
+
+    The mutex is robust: when a process dies holding it (an internal
+    command or the safety monitor being killed), the next locker gets
+    EOWNERDEAD, repairs what a half-finished update can leave behind, marks
+    the mutex consistent and carries on instead of deadlocking the car.
+
+    Liveness is separate from all of this: the car and the safety monitor
+    each store a CLOCK_MONOTONIC timestamp in the segment on their own
+    schedule and check the age of the other's, without taking the mutex.
+    Safety events travel the same way, through a lock-free ring.
+*/
+
+#include "shared.h"
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Most cars one futex_waitv call can sleep on
+#define SHM_WAIT_MAX FUTEX_WAITV_MAX
+
+// Topic masks for shm_notify and shm_wait
+#define SHM_MOTION  (1u << SHM_TOPIC_MOTION)
+#define SHM_DOORS   (1u << SHM_TOPIC_DOORS)
+#define SHM_BUTTONS (1u << SHM_TOPIC_BUTTONS)
+#define SHM_MODES   (1u << SHM_TOPIC_MODES)
+#define SHM_ALL     ((1u << SHM_TOPICS) - 1u)
+
+static inline void shm_futex_wake(uint32_t* word)
+{
+    // Shared mapping, so no FUTEX_PRIVATE_FLAG
+    syscall(SYS_futex, word, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+// Announce a change to the given topics; called with the car's mutex held
+static inline void shm_notify(car_shared_mem* m, unsigned topics)
+{
+    // Bump the words before reading sleepers; a waiter registers before
+    // its words are compared, so one side always sees the other
+    atomic_fetch_add((_Atomic uint32_t*)&m->change_seq, 1u);
+    for (int t = 0; t < SHM_TOPICS; ++t)
+    {
+        if (topics & (1u << t))
+        {
+            atomic_fetch_add((_Atomic uint32_t*)&m->topic_seq[t], 1u);
+        }
+    }
+    if (atomic_load((_Atomic uint32_t*)&m->sleepers) == 0u)
+    {
+        return;
+    }
+    shm_futex_wake(&m->change_seq);
+    for (int t = 0; t < SHM_TOPICS; ++t)
+    {
+        if (topics & (1u << t))
+        {
+            shm_futex_wake(&m->topic_seq[t]);
+        }
+    }
+}
+
+// Make a car's shared memory usable again after its mutex owner died
+// mid-update; called with the mutex held after EOWNERDEAD
+static inline void shm_recover(car_shared_mem* m)
+{
+    // Terminate strings a dead writer may have left half-copied
+    m->current_floor[sizeof m->current_floor - 1] = '\0';
+    m->destination_floor[sizeof m->destination_floor - 1] = '\0';
+    m->status[sizeof m->status - 1] = '\0';
+    // Values that are still invalid are left for the safety monitor to flag
+    pthread_mutex_consistent(&m->mutex);
+    // Waiters re-read everything, since any field may have changed
+    shm_notify(m, SHM_ALL);
+}
+
+// Lock a car's mutex, recovering it if the previous owner died.
+// Returns 0 when locked and an error number otherwise.
+static inline int shm_lock(car_shared_mem* m)
+{
+    int err = pthread_mutex_lock(&m->mutex);
+    if (err == EOWNERDEAD)
+    {
+        shm_recover(m);
+        err = 0;
+    }
+    return err;
+}
+
+// Sleep until one of the topics changes or the absolute CLOCK_MONOTONIC
+// deadline passes. Called with the car's mutex held, which is released
+// while asleep and held again on return, like pthread_cond_timedwait.
+// Returns 0 when woken and ETIMEDOUT or another error number otherwise.
+static inline int shm_wait(car_shared_mem* m, unsigned topics, const struct timespec* deadline)
+{
+    struct futex_waitv waiters[SHM_TOPICS];
+    unsigned n = 0;
+    if ((topics & SHM_ALL) == 0u)
+    {
+        return EINVAL;
+    }
+    memset(waiters, 0, sizeof waiters);
+    atomic_fetch_add((_Atomic uint32_t*)&m->sleepers, 1u);
+    // Snapshot the words while the mutex still excludes writers
+    for (int t = 0; t < SHM_TOPICS; ++t)
+    {
+        if (topics & (1u << t))
+        {
+            waiters[n].uaddr = (uintptr_t)&m->topic_seq[t];
+            waiters[n].val = atomic_load((_Atomic uint32_t*)&m->topic_seq[t]);
+            waiters[n].flags = FUTEX_32;
+            n++;
+        }
+    }
+    uint32_t generation = atomic_load((_Atomic uint32_t*)&m->change_seq);
+    pthread_mutex_unlock(&m->mutex);
+
+    long r = syscall(SYS_futex_waitv, waiters, n, 0u, deadline, CLOCK_MONOTONIC);
+    if (r == -1 && errno == ENOSYS)
+    {
+        // Kernels before 5.16 lack futex_waitv, so sleep on the generation,
+        // which wakes on any topic (absolute deadline, CLOCK_MONOTONIC)
+        r = syscall(SYS_futex, &m->change_seq, FUTEX_WAIT_BITSET, generation, deadline, NULL,
+                    FUTEX_BITSET_MATCH_ANY);
+    }
+    int err = (r >= 0 || errno == EAGAIN || errno == EINTR) ? 0 : errno;
+
+    shm_lock(m);
+    atomic_fetch_sub((_Atomic uint32_t*)&m->sleepers, 1u);
+    return err;
+}
+
+// Current change sequence of a car
+static inline uint32_t shm_change_seq(const car_shared_mem* m)
+{
+    return atomic_load_explicit((const _Atomic uint32_t*)&m->change_seq, memory_order_acquire);
+}
+
+// Sleep until any car's change_seq differs from seen[] or the absolute
+// CLOCK_MONOTONIC deadline passes. Returns 0 when woken or when a car had
+// already changed, and -1 with errno ETIMEDOUT, EINTR or another error.
+static inline int shm_wait_any(car_shared_mem* const cars[], const uint32_t seen[], int n,
+                               const struct timespec* deadline)
+{
+    struct futex_waitv waiters[SHM_WAIT_MAX];
+    if (n < 1 || n > SHM_WAIT_MAX)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    memset(waiters, 0, (size_t)n * sizeof *waiters);
+    for (int i = 0; i < n; ++i)
+    {
+        // Ask writers for the wake before the kernel compares the words
+        atomic_fetch_add((_Atomic uint32_t*)&cars[i]->sleepers, 1u);
+        waiters[i].uaddr = (uintptr_t)&cars[i]->change_seq;
+        waiters[i].val = seen[i];
+        waiters[i].flags = FUTEX_32;
+    }
+    long r = syscall(SYS_futex_waitv, waiters, (unsigned)n, 0u, deadline, CLOCK_MONOTONIC);
+    int err = errno;
+    if (r == -1 && err == ENOSYS)
+    {
+        // Kernels before 5.16 lack futex_waitv, so fall back to the deadline
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, deadline, NULL);
+        err = ETIMEDOUT;
+    }
+    for (int i = 0; i < n; ++i)
+    {
+        atomic_fetch_sub((_Atomic uint32_t*)&cars[i]->sleepers, 1u);
+    }
+    if (r >= 0 || err == EAGAIN)
+    {
+        return 0;
+    }
+    errno = err;
+    return -1;
+}
+
+// Monotonic time in ns; the clock is system wide, so heartbeats written by
+// one process can be aged by another
+static inline uint64_t shm_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// Record a heartbeat
+static inline void shm_beat(uint64_t* beat)
+{
+    atomic_store_explicit((_Atomic uint64_t*)beat, shm_now_ns(), memory_order_release);
+}
+
+// Milliseconds since a heartbeat was recorded (0 if it is in the future)
+static inline uint64_t shm_beat_age_ms(const uint64_t* beat)
+{
+    uint64_t then = atomic_load_explicit((const _Atomic uint64_t*)beat, memory_order_acquire);
+    uint64_t now = shm_now_ns();
+    return now > then ? (now - then) / 1000000ull : 0u;
+}
+
+// Append a safety event without blocking. Returns 0, or -1 and counts a
+// drop when the ring is full. Only one process may append to a ring.
+static inline int shm_event_push(safety_ring_t* r, const safety_event_t* e)
+{
+    uint32_t head = atomic_load_explicit((_Atomic uint32_t*)&r->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit((_Atomic uint32_t*)&r->tail, memory_order_acquire);
+    if (head - tail >= SAFETY_EVENTS)
+    {
+        atomic_fetch_add_explicit((_Atomic uint32_t*)&r->dropped, 1u, memory_order_relaxed);
+        return -1;
+    }
+    r->events[head % SAFETY_EVENTS] = *e;
+    // Publish the event after its contents
+    atomic_store_explicit((_Atomic uint32_t*)&r->head, head + 1u, memory_order_release);
+    return 0;
+}
+
+// Take the oldest safety event. Returns 1 with the event in out, or 0 when
+// the ring is empty. Only one thread may drain a ring.
+static inline int shm_event_pop(safety_ring_t* r, safety_event_t* out)
+{
+    uint32_t tail = atomic_load_explicit((_Atomic uint32_t*)&r->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit((_Atomic uint32_t*)&r->head, memory_order_acquire);
+    if (head == tail)
+    {
+        return 0;
+    }
+    *out = r->events[tail % SAFETY_EVENTS];
+    // Hand the slot back only once it has been copied
+    atomic_store_explicit((_Atomic uint32_t*)&r->tail, tail + 1u, memory_order_release);
+    return 1;
+}
+
+// Lock a car's mutex, giving up after ms so one stuck car cannot stall a
+// supervisor of many. Returns 0 when locked and an error number otherwise.
+static inline int shm_lock_timed(car_shared_mem* m, unsigned ms)
+{
+    struct timespec ts;
+    // pthread_mutex_timedlock measures its deadline on CLOCK_REALTIME
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += ms / 1000u;
+    ts.tv_nsec += (long)(ms % 1000u) * 1000000L;
+    if (ts.tv_nsec >= 1000000000L)
+    {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+    int err = pthread_mutex_timedlock(&m->mutex, &ts);
+    if (err == EOWNERDEAD)
+    {
+        shm_recover(m);
+        err = 0;
+    }
+    return err;
+}
+
+#endif // SHM_SYNC_H
@@ -0,0 +1,191 @@
+// Author: Alexandros Sacranie
+// Module: Safety Critical Monitor (snapshot.c)
+// Project: Distributed Elevator Control System
+
+/* Registry snapshots
+
+    The file holds two slots mapped with MAP_SHARED. A snapshot is built in
+    memory and compared with the newest slot; only when it differs is it
+    written into the older slot, which is first marked invalid by zeroing its
+    sequence number, and published by storing a new sequence number with
+    release ordering once its checksum is in place. A crash mid-write leaves
+    the other slot intact, and the kernel writes dirty pages back in the
+    background so saving never waits on the disk.
+*/
+
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "snapshot.h"
+
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+
+static snapshot_file_t* g_file = NULL;
+// Slot holding the newest snapshot (-1 when none) and its sequence number
+static int g_active = -1;
+static uint64_t g_seq = 0;
+
+//                  Checksums                  //
+
+static uint64_t slot_checksum(const snapshot_slot_t* s)
+{
+    // FNV-1a over the count and the cars in use
+    const unsigned char* p = (const unsigned char*)&s->count;
+    size_t len = offsetof(snapshot_slot_t, cars) - offsetof(snapshot_slot_t, count) +
+                 (size_t)(s->count <= MAX_CARS ? s->count : 0) * sizeof(snapshot_car_t);
+    uint64_t h = 1469598103934665603ull;
+    for (size_t i = 0; i < len; ++i)
+    {
+        h = (h ^ p[i]) * 1099511628211ull;
+    }
+    return h;
+}
+
+static bool slot_valid(const snapshot_slot_t* s)
+{
+    // Published, in range and not torn
+    uint64_t seq = atomic_load_explicit((const _Atomic uint64_t*)&s->seq, memory_order_acquire);
+    return seq != 0 && s->count <= MAX_CARS && s->checksum == slot_checksum(s);
+}
+
+//                  Open and Close                  //
+
+int snapshot_open(const char* path)
+{
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd == -1)
+    {
+        return -1;
+    }
+    // Size the file for the header and both slots
+    if (ftruncate(fd, (off_t)sizeof(snapshot_file_t)) == -1)
+    {
+        close(fd);
+        return -1;
+    }
+    void* p = mmap(NULL, sizeof(snapshot_file_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+    {
+        return -1;
+    }
+    g_file = (snapshot_file_t*)p;
+
+    // Start afresh when the file is new or from another layout
+    if (memcmp(g_file->magic, SNAPSHOT_MAGIC, sizeof g_file->magic) != 0 ||
+        g_file->version != SNAPSHOT_VERSION || g_file->slot_size != sizeof(snapshot_slot_t))
+    {
+        memset(g_file, 0, sizeof *g_file);
+        g_file->version = SNAPSHOT_VERSION;
+        g_file->slot_size = sizeof(snapshot_slot_t);
+        memcpy(g_file->magic, SNAPSHOT_MAGIC, sizeof g_file->magic);
+    }
+
+    // Find the newest valid slot to continue from
+    g_active = -1;
+    g_seq = 0;
+    for (int i = 0; i < 2; ++i)
+    {
+        if (slot_valid(&g_file->slot[i]) && g_file->slot[i].seq > g_seq)
+        {
+            g_active = i;
+            g_seq = g_file->slot[i].seq;
+        }
+    }
+    return 0;
+}
+
+void snapshot_close(void)
+{
+    if (g_file)
+    {
+        munmap(g_file, sizeof *g_file);
+        g_file = NULL;
+    }
+}
+
+//                  Loading and Saving                  //
+
+void snapshot_car(const CarID* car, snapshot_car_t* out)
+{
+    // Zero first so padding and unused entries compare equal
+    memset(out, 0, sizeof *out);
+    memcpy(out->name, car->name, sizeof out->name);
+    out->lowest_floor = car->lowest_floor;
+    out->highest_floor = car->highest_floor;
+    for (int k = 0; k < car->queue_len; ++k)
+    {
+        out->q[k] = car->q[k];
+    }
+    out->queue_len = car->queue_len;
+    for (int k = 0; k < car->trip_count; ++k)
+    {
+        out->trips[k].id = car->trips[k].id;
+        out->trips[k].src_floor = car->trips[k].src_floor;
+        out->trips[k].dst_floor = car->trips[k].dst_floor;
+        out->trips[k].picked_up = car->trips[k].picked_up;
+    }
+    out->trip_count = car->trip_count;
+    out->timing = car->timing;
+}
+
+int snapshot_load(snapshot_car_t out[MAX_CARS])
+{
+    if (!g_file || g_active < 0)
+    {
+        return 0;
+    }
+    // Copy the newest snapshot out of the mapping
+    const snapshot_slot_t* s = &g_file->slot[g_active];
+    memcpy(out, s->cars, (size_t)s->count * sizeof *out);
+    return (int)s->count;
+}
+
+void snapshot_save(const CarID cars[], int n_cars, const snapshot_car_t pending[], int n_pending)
+{
+    if (!g_file)
+    {
+        return;
+    }
+    // Build the snapshot off the mapping so an unchanged registry dirties
+    // no pages and leaves both slots valid
+    static snapshot_car_t scratch[MAX_CARS];
+    uint32_t count = 0;
+    // Copy every registered car
+    for (int i = 0; i < n_cars; ++i)
+    {
+        if (!cars[i].in_use)
+        {
+            continue;
+        }
+        snapshot_car(&cars[i], &scratch[count++]);
+    }
+    // Keep recovered cars until they claim their state
+    for (int i = 0; i < n_pending && count < MAX_CARS; ++i)
+    {
+        scratch[count++] = pending[i];
+    }
+
+    // Skip the write if the registry has not changed
+    if (g_active >= 0 && g_file->slot[g_active].count == count &&
+        memcmp(g_file->slot[g_active].cars, scratch, (size_t)count * sizeof *scratch) == 0)
+    {
+        return;
+    }
+    // Invalidate the older slot before overwriting it
+    int target = g_active == 0 ? 1 : 0;
+    snapshot_slot_t* s = &g_file->slot[target];
+    atomic_store_explicit((_Atomic uint64_t*)&s->seq, 0u, memory_order_release);
+    memcpy(s->cars, scratch, (size_t)count * sizeof *scratch);
+    s->count = count;
+    // Publish the new snapshot
+    s->checksum = slot_checksum(s);
+    atomic_store_explicit((_Atomic uint64_t*)&s->seq, ++g_seq, memory_order_release);
+    g_active = target;
+}
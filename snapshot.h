@@ -0,0 +1,60 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "dispatch.h"
+
+#include <stdint.h>
+
+// Snapshot files start with this magic followed by two state slots
+#define SNAPSHOT_MAGIC "ELEVSNP1"
+#define SNAPSHOT_VERSION 1u
+
+// Persisted state of one registered car
+typedef struct {
+  char name[32];                   // Car name
+  int32_t lowest_floor;            // Service range the car registered with
+  int32_t highest_floor;
+  int32_t q[MAX_QUEUE];            // Queued stops, head first
+  int32_t queue_len;               // Stops in the queue
+  int32_t trip_count;              // Trips in trips[]
+  trip_t trips[MAX_QUEUE];         // Trips awaiting pickup or drop-off
+  car_timing_t timing;             // Learned timings, so ETAs stay warm
+} snapshot_car_t;
+
+// One copy of the registry; the newest slot with a valid checksum wins
+typedef struct {
+  uint64_t seq;                    // Publication number (0 while being written)
+  uint64_t checksum;               // FNV-1a over count and cars[]
+  uint32_t count;                  // Cars in cars[]
+  uint32_t reserved;
+  snapshot_car_t cars[MAX_CARS];   // Registered cars
+} snapshot_slot_t;
+
+// File layout
+typedef struct {
+  char magic[8];                   // SNAPSHOT_MAGIC
+  uint32_t version;                // SNAPSHOT_VERSION
+  uint32_t slot_size;              // sizeof(snapshot_slot_t)
+  uint8_t reserved[48];            // Pads the header to 64 bytes
+  snapshot_slot_t slot[2];         // Double buffer
+} snapshot_file_t;
+
+// Map a snapshot file, creating it if needed. A file written by a
+// different layout is started afresh. Returns 0 on success and -1 on error.
+int snapshot_open(const char* path);
+
+// Unmap the snapshot file
+void snapshot_close(void);
+
+// Fill a snapshot record from a registered car (unused bytes are zeroed)
+void snapshot_car(const CarID* car, snapshot_car_t* out);
+
+// Copy the newest valid snapshot into out; returns the number of cars
+int snapshot_load(snapshot_car_t out[MAX_CARS]);
+
+// Write the registered cars, followed by recovered cars that have not
+// re-registered yet, to the older slot and publish it. Skipped when nothing
+// changed since the last snapshot. The caller holds the registry lock.
+void snapshot_save(const CarID cars[], int n_cars, const snapshot_car_t pending[], int n_pending);
+
+#endif // SNAPSHOT_H
@@ -0,0 +1,160 @@
+// Author: Alexandros Sacranie
+// Module: Safety Critical Monitor (tcp_util.c)
+// Project: Distributed Elevator Control System
+
+/* Framing over TCP
+
+    Every endpoint speaks the same framing: a 16-bit length in network
+    order followed by that many bytes of ASCII. The helpers are built
+    optimised into libelevator.a and linked by every program.
+*/
+
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "tcp_util.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+ssize_t write_all(int fd, const void* buf, size_t n)
+{
+    // Point to the current position in the buffer
+    // and track bytes left to write
+    const unsigned char* p = (const unsigned char*)buf;
+    size_t left = n;
+    // Write until no bytes left to write
+    while (left > 0)
+    {
+        // Track bytes written
+        // and catch errors
+        ssize_t Written = write(fd, p, left);
+        if (Written < 0)
+        {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        else if (Written == 0)
+        {
+            return -1;
+        }
+        // Shift the buffer pointer and decrease count
+        p += Written;
+        left -= (size_t)Written;
+    }
+    // Return total bytes written
+    return (ssize_t)n;
+}
+
+ssize_t read_all(int fd, void* buf, size_t n)
+{
+    // Point to the current position in the buffer
+    // and track bytes left to read
+    unsigned char* p = (unsigned char*)buf;
+    size_t left = n;
+    // Read until no bytes left to read
+    while (left > 0)
+    {
+        // Track bytes read and catch errors
+        ssize_t Read = read(fd, p, left);
+        if (Read < 0)
+        {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        else if (Read == 0)
+        {
+            return -1;
+        }
+        // Shift the buffer pointer and decrease count
+        p += Read;
+        left -= (size_t)Read;
+    }
+    // Return total bytes read
+    return (ssize_t)n;
+}
+
+int send_frame(int fd, const char* s)
+{
+    // Store length of message sent
+    size_t len = strlen(s);
+    // Clamp the message to 16 bits
+    if (len > 0xFFFF)
+    {
+        len = 0xFFFF;
+    }
+    // Convert to network order
+    uint16_t nlen = htons((uint16_t)len);
+    // Send the length of the message first
+    if (write_all(fd, &nlen, sizeof nlen) < 0) 
+    {
+        return -1;
+    }
+    // Send the message second
+    if (write_all(fd, s, len) < 0)
+    {
+        return -1;
+    }
+    // Message sent successfully
+    return 0;
+}
+
+int receive_frame(int fd, char* buf, size_t capacity)
+{
+    // Create a variable for incoming message length
+    uint16_t hlen;
+
+    // Attempt read of message length
+    if (read_all(fd, &hlen, sizeof hlen) < 0)
+    {
+        return -1;
+    }
+
+    // Revert length from network order
+    size_t len = ntohs(hlen);
+
+    // Check to make sure the incoming message is
+    // smaller than the buffer
+    if (len >= capacity)
+    {
+        // Read what can fit and make room for null terminator
+        size_t keep = capacity - 1;
+        if (read_all(fd, buf, keep) < 0)
+        {
+            return -1;
+        }
+
+        // Store the remainder in a temporary buffer
+        // to read and discard
+        size_t remainder = len - keep;
+        char dump[512];
+
+        while (remainder > 0)
+        {
+            // Attempt read of the remainder
+            size_t chunk = remainder > sizeof dump ? sizeof dump : remainder;
+            if (read_all(fd, dump, chunk) < 0) 
+            {
+                return -1;
+            }
+            remainder -= chunk;
+        }
+
+        buf[capacity - 1] = '\0';
+    }
+    // Othrwise read normally
+    else
+    {
+        if (read_all(fd, buf, len) < 0)
+        {
+            return -1;
+        }
+        buf[len] = '\0';
+    }
+    // Message received successfully
+    return 0;
+}
@@ -0,0 +1,21 @@
+#ifndef TCP_UTIL_H
+#define TCP_UTIL_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+// Write all n bytes, retrying short writes and EINTR; returns n or -1
+ssize_t write_all(int fd, const void* buf, size_t n);
+
+// Read exactly n bytes, retrying short reads and EINTR; returns n or -1
+// (also when the peer closes first)
+ssize_t read_all(int fd, void* buf, size_t n);
+
+// Send a C string as one frame (clamped to 65535 bytes); returns 0 or -1
+int send_frame(int fd, const char* s);
+
+// Receive one frame into buf as a C string, discarding what does not fit
+// in capacity - 1 bytes; returns 0 or -1
+int receive_frame(int fd, char* buf, size_t capacity);
+
+#endif // TCP_UTIL_H
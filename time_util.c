@@ -0,0 +1,70 @@
+// Author: Alexandros Sacranie
+// Module: Safety Critical Monitor (time_util.c)
+// Project: Distributed Elevator Control System
+
+/* Clocks and delays
+
+    Every timeout and deadline in the system is measured on CLOCK_MONOTONIC,
+    so wall clock adjustments cannot stretch or cut one short.
+*/
+
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "time_util.h"
+
+#include <errno.h>
+
+long now_ms(void)
+{
+    // Read the monotonic clock in milliseconds
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long)ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+long long mono_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+struct timespec abs_timeout_ms(unsigned ms)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    // Add the delay to find the absolute time to wake
+    ts.tv_sec += ms / 1000u;
+    // Handle conditions where nanosec exceeds a second
+    ts.tv_nsec += (long)(ms % 1000u) * 1000000L;
+    if (ts.tv_nsec >= 1000000000L)
+    {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+    // return absolute time
+    return ts;
+}
+
+struct timespec ns_to_timespec(long long ns)
+{
+    struct timespec ts;
+    ts.tv_sec = (time_t)(ns / 1000000000LL);
+    ts.tv_nsec = (long)(ns % 1000000000LL);
+    return ts;
+}
+
+void sleep_ms(unsigned ms)
+{
+    // Pauses the thread for a specific delay (ms)
+    struct timespec ts;
+    // Convert whole ms to sec
+    ts.tv_sec = ms / 1000u;
+    // Convert remainder to ns
+    ts.tv_nsec = (long)(ms % 1000u) * 1000000L;
+    // Pause for the remaining delay after a signal
+    while (nanosleep(&ts, &ts) == -1 && errno == EINTR)
+    {}
+}
@@ -0,0 +1,22 @@
+#ifndef TIME_UTIL_H
+#define TIME_UTIL_H
+
+#include <time.h>
+
+// Monotonic time in milliseconds
+long now_ms(void);
+
+// Monotonic time in nanoseconds
+long long mono_ns(void);
+
+// Absolute CLOCK_MONOTONIC time ms from now, for timed waits on
+// monotonic condition variables and futexes
+struct timespec abs_timeout_ms(unsigned ms);
+
+// Split nanoseconds into a timespec
+struct timespec ns_to_timespec(long long ns);
+
+// Sleep for ms, resuming after signals
+void sleep_ms(unsigned ms);
+
+#endif // TIME_UTIL_H
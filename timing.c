@@ -0,0 +1,131 @@
+// Author: Alexandros Sacranie
+// Module: Safety Critical Monitor (timing.c)
+// Project: Distributed Elevator Control System
+
+#include "timing.h"
+
+#include <string.h>
+
+//                  Bucket Mapping                  //
+
+static int bucket_of(long ms)
+{
+    // Durations below the first full octave map directly
+    if (ms < TIMING_SUB_BUCKETS)
+    {
+        return ms < 0 ? 0 : (int)ms;
+    }
+    // Find the octave from the highest set bit
+    int octave = 63 - __builtin_clzl((unsigned long)ms);
+    // Take the next bits below it as the sub-bucket
+    int sub = (int)((ms >> (octave - 2)) & (TIMING_SUB_BUCKETS - 1));
+    int b = (octave - 1) * TIMING_SUB_BUCKETS + sub;
+    return b < TIMING_BUCKETS ? b : TIMING_BUCKETS - 1;
+}
+
+static long bucket_low(int b)
+{
+    // Inverse of bucket_of for the lowest value in a bucket
+    if (b < TIMING_SUB_BUCKETS)
+    {
+        return b;
+    }
+    int octave = b / TIMING_SUB_BUCKETS + 1;
+    int sub = b % TIMING_SUB_BUCKETS;
+    return (long)(TIMING_SUB_BUCKETS + sub) << (octave - 2);
+}
+
+//                  Histogram                  //
+
+static void hist_add(timing_hist_t* h, long ms)
+{
+    // Clamp to the range a sample slot can hold
+    if (ms < 0)
+    {
+        ms = 0;
+    }
+    else if (ms > TIMING_MAX_MS)
+    {
+        ms = TIMING_MAX_MS;
+    }
+    // Evict the oldest sample once the window is full
+    if (h->len == TIMING_WINDOW)
+    {
+        h->count[bucket_of(h->sample[h->head])]--;
+    }
+    else
+    {
+        h->len++;
+    }
+    // Store the new sample and count it
+    h->sample[h->head] = (uint16_t)ms;
+    h->count[bucket_of(ms)]++;
+    h->head = (uint8_t)((h->head + 1) % TIMING_WINDOW);
+}
+
+long timing_median(const timing_hist_t* h)
+{
+    // Nothing observed yet
+    if (h->len == 0)
+    {
+        return -1;
+    }
+    // Walk the buckets to the one holding the middle sample
+    int rank = h->len / 2;
+    for (int b = 0; b < TIMING_BUCKETS; ++b)
+    {
+        if (rank < h->count[b])
+        {
+            // Interpolate within the bucket by the sample's rank
+            long lo = bucket_low(b);
+            long hi = (b + 1 < TIMING_BUCKETS) ? bucket_low(b + 1) : TIMING_MAX_MS + 1;
+            return lo + (hi - lo) * (2 * rank + 1) / (2 * h->count[b]);
+        }
+        rank -= h->count[b];
+    }
+    return TIMING_MAX_MS;
+}
+
+//                  Timing Model                  //
+
+static long estimate(const car_timing_t* t, int kind)
+{
+    // Use the learned median once the status has been observed
+    long m = timing_median(&t->hist[kind]);
+    return m >= 0 ? m : t->default_ms[kind];
+}
+
+void timing_init(car_timing_t* t, long floor_ms, long door_ms)
+{
+    memset(t, 0, sizeof *t);
+    // The door cycle is split evenly over its three statuses
+    t->default_ms[TIMING_OPENING] = door_ms / 3;
+    t->default_ms[TIMING_OPEN] = door_ms / 3;
+    t->default_ms[TIMING_CLOSING] = door_ms - 2 * (door_ms / 3);
+    t->default_ms[TIMING_BETWEEN] = floor_ms;
+    t->floor_ms = floor_ms;
+    t->door_ms = door_ms;
+}
+
+int timing_kind(const char* status)
+{
+    // Closed has no fixed duration so it is not measured
+    if (strcmp(status, "Opening") == 0) return TIMING_OPENING;
+    if (strcmp(status, "Open") == 0) return TIMING_OPEN;
+    if (strcmp(status, "Closing") == 0) return TIMING_CLOSING;
+    if (strcmp(status, "Between") == 0) return TIMING_BETWEEN;
+    return -1;
+}
+
+void timing_record(car_timing_t* t, int kind, long ms)
+{
+    // Ignore statuses that are not measured
+    if (kind < 0 || kind >= TIMING_KINDS)
+    {
+        return;
+    }
+    hist_add(&t->hist[kind], ms);
+    // Refresh the estimates used by dispatch
+    t->floor_ms = estimate(t, TIMING_BETWEEN);
+    t->door_ms = estimate(t, TIMING_OPENING) + estimate(t, TIMING_OPEN) + estimate(t, TIMING_CLOSING);
+}
@@ -0,0 +1,51 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <stdint.h>
+
+// Rolling histogram sizing: 4 buckets per power of two from 1 ms up to
+// 65 s, remembering the last TIMING_WINDOW samples of each transition
+#define TIMING_SUB_BUCKETS 4
+#define TIMING_BUCKETS (16 * TIMING_SUB_BUCKETS)
+#define TIMING_WINDOW 32
+#define TIMING_MAX_MS 65535L
+
+// Statuses whose duration is measured when the car leaves them
+typedef enum
+{
+    TIMING_OPENING,
+    TIMING_OPEN,
+    TIMING_CLOSING,
+    TIMING_BETWEEN,
+    TIMING_KINDS
+} timing_kind_t;
+
+// Rolling histogram of the durations of one status
+typedef struct {
+  uint8_t count[TIMING_BUCKETS];   // Samples in the window per bucket
+  uint16_t sample[TIMING_WINDOW];  // Window of raw samples (ms) for eviction
+  uint8_t head;                    // Next slot to overwrite in the window
+  uint8_t len;                     // Samples currently in the window
+} timing_hist_t;
+
+// Learned timing model of one car
+typedef struct {
+  timing_hist_t hist[TIMING_KINDS]; // Durations per measured status
+  long default_ms[TIMING_KINDS];    // Used until a status has been observed
+  long floor_ms;                    // Estimated travel time per floor
+  long door_ms;                     // Estimated Opening + Open + Closing time
+} car_timing_t;
+
+// Reset the model and start from default travel and door cycle times
+void timing_init(car_timing_t* t, long floor_ms, long door_ms);
+
+// Map a STATUS string to the histogram measuring it (-1 if not measured)
+int timing_kind(const char* status);
+
+// Record the time spent in a status and refresh the derived estimates
+void timing_record(car_timing_t* t, int kind, long ms);
+
+// Median of a histogram in ms (-1 while empty)
+long timing_median(const timing_hist_t* h);
+
+#endif // TIMING_H
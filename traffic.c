@@ -0,0 +1,257 @@
+// Author: Alexandros Sacranie
+// Module: Safety Critical Monitor (traffic.c)
+// Project: Distributed Elevator Control System
+
+/* Demand forecasting for call-origin traffic
+
+    Counters decay exponentially without touching every cell: each call adds
+    a weight that grows as 2^(age / half life) since an epoch, and reads divide
+    by the current weight. When the weight grows large every counter is scaled
+    down once and the epoch restarts, so recording and querying are O(1) and
+    all storage is static. Time comes from the caller rather than a clock, so
+    the replay tool decays counters over trace time exactly as the controller
+    did live.
+*/
+
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "traffic.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+
+// Rescale once the inflated weight reaches 2^32
+#define TRAFFIC_RESCALE 4294967296.0
+
+// Structure to hold one floor pair counter
+typedef struct
+{
+    int16_t src, dst;   // Floors of the pair (src 0 marks a free entry)
+    int16_t slot;       // Time of day slot
+    double weight;      // Inflated decayed count
+} pair_t;
+
+static double g_origin[TRAFFIC_SLOTS][TRAFFIC_FLOORS];
+static double g_slot_total[TRAFFIC_SLOTS];
+static pair_t g_pairs[TRAFFIC_PAIRS];
+static double g_half_life_s = 86400.0;
+static double g_epoch_s = 0.0;
+static pthread_mutex_t g_traffic_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+//                  Decay Helpers                 //
+
+static double to_s(long now_ms)
+{
+    // Decay is computed in seconds
+    return (double)now_ms / 1000.0;
+}
+
+static double inflate(double now)
+{
+    // Weight of a call made now relative to the epoch
+    return exp2((now - g_epoch_s) / g_half_life_s);
+}
+
+static void rescale(double now)
+{
+    // Deflate every counter to the current time and restart the epoch
+    double k = 1.0 / inflate(now);
+    for (int s = 0; s < TRAFFIC_SLOTS; ++s)
+    {
+        for (int f = 0; f < TRAFFIC_FLOORS; ++f)
+        {
+            g_origin[s][f] *= k;
+        }
+        g_slot_total[s] *= k;
+    }
+    for (int i = 0; i < TRAFFIC_PAIRS; ++i)
+    {
+        g_pairs[i].weight *= k;
+    }
+    g_epoch_s = now;
+}
+
+static unsigned pair_hash(int src, int dst, int slot)
+{
+    // Mix the key into a table index
+    uint32_t h = (uint32_t)(src - TRAFFIC_MIN_FLOOR) * 2654435761u;
+    h ^= (uint32_t)(dst - TRAFFIC_MIN_FLOOR) * 2246822519u;
+    h ^= (uint32_t)slot * 3266489917u;
+    return (h ^ (h >> 15)) % TRAFFIC_PAIRS;
+}
+
+static int valid_floor(int f)
+{
+    return f >= TRAFFIC_MIN_FLOOR && f <= TRAFFIC_MAX_FLOOR && f != 0;
+}
+
+//                  Recording                 //
+
+void traffic_init(double half_life_s, long now_ms)
+{
+    pthread_mutex_lock(&g_traffic_mtx);
+    memset(g_origin, 0, sizeof g_origin);
+    memset(g_slot_total, 0, sizeof g_slot_total);
+    memset(g_pairs, 0, sizeof g_pairs);
+    g_half_life_s = half_life_s > 0.0 ? half_life_s : 86400.0;
+    g_epoch_s = to_s(now_ms);
+    pthread_mutex_unlock(&g_traffic_mtx);
+}
+
+int traffic_slot(time_t when)
+{
+    // Bucket by local hour of day
+    struct tm local;
+    localtime_r(&when, &local);
+    return local.tm_hour % TRAFFIC_SLOTS;
+}
+
+void traffic_record(int src_floor, int dst_floor, time_t when, long now_ms)
+{
+    // Ignore floors outside the table
+    if (!valid_floor(src_floor) || !valid_floor(dst_floor))
+    {
+        return;
+    }
+    int slot = traffic_slot(when);
+
+    pthread_mutex_lock(&g_traffic_mtx);
+    double now = to_s(now_ms);
+    double w = inflate(now);
+    // Keep inflated weights in range
+    if (w >= TRAFFIC_RESCALE)
+    {
+        rescale(now);
+        w = 1.0;
+    }
+    // Count the origin
+    g_origin[slot][src_floor - TRAFFIC_MIN_FLOOR] += w;
+    g_slot_total[slot] += w;
+
+    // Find the pair or a free entry in the probe window,
+    // otherwise replace the weakest pair in the window
+    unsigned h = pair_hash(src_floor, dst_floor, slot);
+    pair_t* victim = NULL;
+    for (int p = 0; p < TRAFFIC_PROBE; ++p)
+    {
+        pair_t* e = &g_pairs[(h + (unsigned)p) % TRAFFIC_PAIRS];
+        if (e->src == src_floor && e->dst == dst_floor && e->slot == slot)
+        {
+            victim = e;
+            break;
+        }
+        if (!victim || (victim->src != 0 && (e->src == 0 || e->weight < victim->weight)))
+        {
+            victim = e;
+        }
+    }
+    if (victim->src != src_floor || victim->dst != dst_floor || victim->slot != slot)
+    {
+        victim->src = (int16_t)src_floor;
+        victim->dst = (int16_t)dst_floor;
+        victim->slot = (int16_t)slot;
+        victim->weight = 0.0;
+    }
+    victim->weight += w;
+    pthread_mutex_unlock(&g_traffic_mtx);
+}
+
+//                  Queries                 //
+
+double traffic_origin_rate(int floor, int slot, long now_ms)
+{
+    if (!valid_floor(floor) || slot < 0 || slot >= TRAFFIC_SLOTS)
+    {
+        return 0.0;
+    }
+    pthread_mutex_lock(&g_traffic_mtx);
+    double r = g_origin[slot][floor - TRAFFIC_MIN_FLOOR] / inflate(to_s(now_ms));
+    pthread_mutex_unlock(&g_traffic_mtx);
+    return r;
+}
+
+double traffic_origin_share(int floor, int slot)
+{
+    if (!valid_floor(floor) || slot < 0 || slot >= TRAFFIC_SLOTS)
+    {
+        return 0.0;
+    }
+    // Both counters decay alike so their ratio needs no deflation
+    pthread_mutex_lock(&g_traffic_mtx);
+    double total = g_slot_total[slot];
+    double r = total > 0.0 ? g_origin[slot][floor - TRAFFIC_MIN_FLOOR] / total : 0.0;
+    pthread_mutex_unlock(&g_traffic_mtx);
+    return r;
+}
+
+double traffic_pair_rate(int src_floor, int dst_floor, int slot, long now_ms)
+{
+    double r = 0.0;
+    if (!valid_floor(src_floor) || !valid_floor(dst_floor) || slot < 0 || slot >= TRAFFIC_SLOTS)
+    {
+        return r;
+    }
+    pthread_mutex_lock(&g_traffic_mtx);
+    unsigned h = pair_hash(src_floor, dst_floor, slot);
+    // Search the probe window for the pair
+    for (int p = 0; p < TRAFFIC_PROBE; ++p)
+    {
+        const pair_t* e = &g_pairs[(h + (unsigned)p) % TRAFFIC_PAIRS];
+        if (e->src == src_floor && e->dst == dst_floor && e->slot == slot)
+        {
+            r = e->weight / inflate(to_s(now_ms));
+            break;
+        }
+    }
+    pthread_mutex_unlock(&g_traffic_mtx);
+    return r;
+}
+
+void traffic_origins(int slot, int lowest, int highest, double out[], long now_ms)
+{
+    pthread_mutex_lock(&g_traffic_mtx);
+    double k = 1.0 / inflate(to_s(now_ms));
+    // Deflate each floor's weight, floors outside the table read as 0
+    for (int f = lowest; f <= highest; ++f)
+    {
+        out[f - lowest] = (valid_floor(f) && slot >= 0 && slot < TRAFFIC_SLOTS) ? g_origin[slot][f - TRAFFIC_MIN_FLOOR] * k : 0.0;
+    }
+    pthread_mutex_unlock(&g_traffic_mtx);
+}
+
+//                  Dump                 //
+
+int traffic_dump(FILE* out, long now_ms)
+{
+    pthread_mutex_lock(&g_traffic_mtx);
+    double k = 1.0 / inflate(to_s(now_ms));
+    // Header line describes the format
+    fprintf(out, "# traffic v1 half_life_s=%.0f slots=%d\n", g_half_life_s, TRAFFIC_SLOTS);
+    fprintf(out, "kind,slot,src,dst,weight\n");
+    // Origin counters per slot
+    for (int s = 0; s < TRAFFIC_SLOTS; ++s)
+    {
+        for (int f = 0; f < TRAFFIC_FLOORS; ++f)
+        {
+            if (g_origin[s][f] > 0.0)
+            {
+                fprintf(out, "origin,%d,%d,,%.4f\n", s, f + TRAFFIC_MIN_FLOOR, g_origin[s][f] * k);
+            }
+        }
+    }
+    // Floor pair counters
+    for (int i = 0; i < TRAFFIC_PAIRS; ++i)
+    {
+        if (g_pairs[i].src != 0)
+        {
+            fprintf(out, "pair,%d,%d,%d,%.4f\n", g_pairs[i].slot, g_pairs[i].src, g_pairs[i].dst, g_pairs[i].weight * k);
+        }
+    }
+    pthread_mutex_unlock(&g_traffic_mtx);
+    // Report write errors to the caller
+    return ferror(out) ? -1 : 0;
+}
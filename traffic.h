@@ -0,0 +1,45 @@
+#ifndef TRAFFIC_H
+#define TRAFFIC_H
+
+#include <stdio.h>
+#include <time.h>
+
+// Time of day is bucketed into hourly slots
+#define TRAFFIC_SLOTS 24
+// Floors B99 to 999 as stored by the controller
+#define TRAFFIC_MIN_FLOOR (-99)
+#define TRAFFIC_MAX_FLOOR 999
+#define TRAFFIC_FLOORS (TRAFFIC_MAX_FLOOR - TRAFFIC_MIN_FLOOR + 1)
+// Capacity of the floor pair table and the probe window searched per pair
+#define TRAFFIC_PAIRS 4096
+#define TRAFFIC_PROBE 8
+
+// Reset all counters; weights halve every half_life_s seconds. Every now_ms
+// below is on the caller's clock (monotonic in the controller, trace time in
+// replay), which drives the decay.
+void traffic_init(double half_life_s, long now_ms);
+
+// Time of day slot for a wall clock time
+int traffic_slot(time_t when);
+
+// Count a call from src to dst made at the given wall clock time (which
+// picks the slot) and at now_ms
+void traffic_record(int src_floor, int dst_floor, time_t when, long now_ms);
+
+// Decayed number of calls from a floor in a slot
+double traffic_origin_rate(int floor, int slot, long now_ms);
+
+// Fraction of a slot's calls that start at a floor (0 with no history);
+// decay cancels out of the ratio so it needs no time
+double traffic_origin_share(int floor, int slot);
+
+// Decayed number of calls between two floors in a slot
+double traffic_pair_rate(int src_floor, int dst_floor, int slot, long now_ms);
+
+// Copy the decayed origin weights of floors lowest..highest in a slot
+void traffic_origins(int slot, int lowest, int highest, double out[], long now_ms);
+
+// Write all non-zero counters, decayed to now_ms, as CSV for offline analysis
+int traffic_dump(FILE* out, long now_ms);
+
+#endif // TRAFFIC_H